@@ -36,6 +36,13 @@ bool SetSeed (const unsigned long seed[6]);
 void AdvanceState (long e, long c);
 
 
+void SetPosition (unsigned long long stream, unsigned long long substream,
+                  unsigned long long offset = 0);
+
+
+void AdvanceSubstream (unsigned long long n);
+
+
 void GetState (unsigned long seed[6]) const;
 
 
@@ -66,6 +73,9 @@ std::string name;
 static double nextSeed[6];
 
 
+static double packageSeed[6];
+
+
 double U01 ();
 
 
@@ -0,0 +1,307 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+// Batch of experiments described in a text file. Every non-empty line that does not start with '#'
+// is one experiment given by key=value pairs, for example
+//
+//     name=base T=1e6 l1=1 l2=1 mu=3.5 male_limit=10 female_limit=10 replications=8 estimator=regenerative confidence=0.95
+//
+// Estimator is one of regenerative (asymptotic normal), jackknife, percentile or bca (bootstrap with `resamples` samples).
+// Replications must be at least 1 and confidence lies in (0, 1).
+//
+// A line "threads=N" (N >= 1) sets the number of threads for the whole batch, a line "progress=PATH" makes runs publish
+// their progress into file PATH (read it with out.exe --monitor PATH).
+// Omitted keys take default values of Experiment_spec.
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <omp.h>
+#include "system.h"
+#include "bootstrap.h"
+
+
+using FP = double;
+
+
+struct Experiment_spec
+{
+    std::string name = "experiment";
+    FP T = 1000;
+    FP l1 = 1;
+    FP l2 = 1;
+    FP mu = 1;
+    size_t male_limit = UINT32_MAX;
+    size_t female_limit = UINT32_MAX;
+    size_t replications = 1;
+    std::string estimator = "regenerative";
+    FP confidence = 0.95;
+    size_t resamples = 10000;
+};
+
+
+struct Experiment_result
+{
+    Experiment_spec spec;
+    Regenerative_accumulator cycles;
+    FP estimate = 0;
+    FP lower = 0;
+    FP upper = 0;
+    FP downtime = 0;
+    size_t total_male = 0;
+    size_t total_female = 0;
+    size_t total_male_left = 0;
+    size_t total_female_left = 0;
+    FP seconds = 0;  // Sum of wall time of replications
+
+    // (cost, clients) pairs of all cycles; kept only for resampling estimators
+    std::vector<FP> cycle_costs;
+    std::vector<FP> cycle_clients;
+};
+
+
+struct Batch
+{
+    std::vector<Experiment_spec> experiments;
+    size_t threads = omp_get_max_threads();
+    std::string progress;  // Path of progress file, empty if not published
+};
+
+
+bool needs_cycles(const std::string& estimator)
+{
+    return estimator == "jackknife" || estimator == "percentile" || estimator == "bca";
+}
+
+// Whole value must be a number: stod alone reads "5x" as 5 and stoul wraps "-1" around
+FP parse_real(const std::string& value)
+{
+    size_t end = 0;
+    FP x = std::stod(value, &end);
+    if (end != value.size())
+        throw std::invalid_argument(value);
+    return x;
+}
+
+size_t parse_count(const std::string& value)
+{
+    size_t end = 0;
+    if (value.empty() || value[0] == '-')
+        throw std::invalid_argument(value);
+    size_t x = std::stoul(value, &end);
+    if (end != value.size())
+        throw std::invalid_argument(value);
+    return x;
+}
+
+
+// Returns false if the file cannot be read or has invalid lines; every invalid line is reported
+bool read_batch(const std::string& path, Batch& batch)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "ERROR: cannot open batch file " << path << ".\n";
+        return false;
+    }
+
+    bool ok = true;
+    std::string line;
+    for (size_t line_number = 1; std::getline(in, line); ++line_number)
+    {
+        std::istringstream tokens(line);
+        std::string token;
+        if (!(tokens >> token) || token[0] == '#')
+            continue;
+
+        Experiment_spec spec;
+        bool is_experiment = false;
+        bool line_ok = true;
+        do
+        {
+            size_t eq = token.find('=');
+            if (eq == std::string::npos)
+            {
+                line_ok = false;
+                break;
+            }
+            std::string key = token.substr(0, eq);
+            std::string value = token.substr(eq + 1);
+
+            try
+            {
+                if (key == "threads")
+                {
+                    size_t threads = parse_count(value);
+                    line_ok = threads > 0;  // num_threads(0) is not a valid OpenMP clause
+                    if (line_ok)
+                        batch.threads = threads;
+                }
+                else if (key == "progress") batch.progress = value;
+                else
+                {
+                    is_experiment = true;
+                    if (key == "name") spec.name = value;
+                    else if (key == "T") spec.T = parse_real(value);
+                    else if (key == "l1") spec.l1 = parse_real(value);
+                    else if (key == "l2") spec.l2 = parse_real(value);
+                    else if (key == "mu") spec.mu = parse_real(value);
+                    else if (key == "male_limit") spec.male_limit = parse_count(value);
+                    else if (key == "female_limit") spec.female_limit = parse_count(value);
+                    else if (key == "replications") line_ok = (spec.replications = parse_count(value)) > 0;
+                    else if (key == "estimator") line_ok = (spec.estimator = value) == "regenerative" || needs_cycles(value);
+                    else if (key == "confidence") line_ok = (spec.confidence = parse_real(value)) > 0 && spec.confidence < 1;
+                    else if (key == "resamples") spec.resamples = parse_count(value);
+                    else line_ok = false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                line_ok = false;
+            }
+        } while (line_ok && tokens >> token);
+
+        if (!line_ok)
+        {
+            std::cerr << "ERROR: " << path << ":" << line_number << ": invalid entry \"" << token << "\".\n";
+            ok = false;
+        }
+        else if (is_experiment)
+            batch.experiments.push_back(spec);
+    }
+    return ok;
+}
+
+
+// Computes estimate and interval of one experiment from its accumulated cycles
+void finish_estimate(Experiment_result& result)
+{
+    const Experiment_spec& spec = result.spec;
+    result.estimate = result.cycles.value();
+
+    std::array<FP, 2> interval;
+    if (needs_cycles(spec.estimator))
+    {
+        size_t resamples = (spec.estimator == "jackknife") ? 0 : spec.resamples;
+        Ratio_intervals intervals = ratio_intervals(result.cycle_costs, result.cycle_clients, spec.confidence, resamples);
+        if (spec.estimator == "jackknife") interval = intervals.jackknife;
+        else if (spec.estimator == "percentile") interval = intervals.percentile;
+        else interval = intervals.bca;
+
+        result.cycle_costs = std::vector<FP>();
+        result.cycle_clients = std::vector<FP>();
+    }
+    else
+    {
+        if (spec.estimator != "regenerative")
+            std::cerr << "WARNING: unknown estimator " << spec.estimator << " in " << spec.name << ", regenerative is used.\n";
+        interval = result.cycles.confidence_interval(spec.confidence);
+    }
+
+    result.lower = interval[0];
+    result.upper = interval[1];
+}
+
+
+// Runs replications of all experiments in one parallel loop, so the threads (and their allocator caches)
+// are created once for the whole batch and small experiments do not wait for each other
+std::vector<Experiment_result> run_batch(const Batch& batch)
+{
+    std::vector<Experiment_result> results(batch.experiments.size());
+    std::vector<System> systems;
+    std::vector<std::pair<size_t, size_t>> tasks;  // {experiment, replication}
+
+    for (size_t e = 0; e < batch.experiments.size(); ++e)
+    {
+        const Experiment_spec& spec = batch.experiments[e];
+        results[e].spec = spec;
+
+        systems.emplace_back(spec.T, spec.l1, spec.l2, spec.mu);
+        systems.back().set_queues_limits(spec.male_limit, spec.female_limit);
+
+        for (size_t r = 0; r < spec.replications; ++r)
+            tasks.push_back({e, r});
+    }
+
+    std::unique_ptr<Progress_board> progress;
+    if (!batch.progress.empty())
+    {
+        // A slot for every thread of the batch and of runs outside it
+        progress = std::make_unique<Progress_board>(batch.progress, std::max(batch.threads, size_t(omp_get_max_threads())));
+        for (System& system : systems)
+            system.set_progress(progress.get());
+    }
+
+    std::vector<RngStream> streams(tasks.size());
+    std::vector<Experiment_result> replication_results(tasks.size());
+
+    #pragma omp parallel for schedule(dynamic) num_threads(batch.threads)
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        System::Statistics stat = systems[tasks[i].first].run<COLLECT_ESTIMATOR>(streams[i]);
+
+        Experiment_result& r = replication_results[i];
+        bool keep_cycles = needs_cycles(batch.experiments[tasks[i].first].estimator);
+        for (size_t c = 0; c < stat.cycle_cost_value.size(); ++c)
+        {
+            FP clients = FP(stat.cycle_male_arrivals[c] + stat.cycle_female_arrivals[c]);
+            r.cycles.add(stat.cycle_cost_value[c], clients);
+            if (keep_cycles)
+            {
+                r.cycle_costs.push_back(stat.cycle_cost_value[c]);
+                r.cycle_clients.push_back(clients);
+            }
+        }
+        r.downtime = stat.downtime;
+        r.total_male = stat.total_male;
+        r.total_female = stat.total_female;
+        r.total_male_left = stat.total_male_left;
+        r.total_female_left = stat.total_female_left;
+        r.seconds = std::chrono::duration<FP>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        Experiment_result& total = results[tasks[i].first];
+        const Experiment_result& r = replication_results[i];
+        total.cycles.merge(r.cycles);
+        total.downtime += r.downtime;
+        total.total_male += r.total_male;
+        total.total_female += r.total_female;
+        total.total_male_left += r.total_male_left;
+        total.total_female_left += r.total_female_left;
+        total.seconds += r.seconds;
+        total.cycle_costs.insert(total.cycle_costs.end(), r.cycle_costs.begin(), r.cycle_costs.end());
+        total.cycle_clients.insert(total.cycle_clients.end(), r.cycle_clients.begin(), r.cycle_clients.end());
+    }
+
+    for (Experiment_result& result : results)
+        finish_estimate(result);
+
+    return results;
+}
+
+
+void write_results_csv(std::ostream& out, const std::vector<Experiment_result>& results)
+{
+    out << "name,T,l1,l2,mu,male_limit,female_limit,replications,estimator,confidence,"
+           "cycles,estimate,lower,upper,downtime,total_male,total_female,male_left,female_left,seconds\n";
+    out.precision(10);
+    for (const Experiment_result& r : results)
+    {
+        const Experiment_spec& s = r.spec;
+        out << s.name << ',' << s.T << ',' << s.l1 << ',' << s.l2 << ',' << s.mu << ','
+            << s.male_limit << ',' << s.female_limit << ',' << s.replications << ',' << s.estimator << ',' << s.confidence << ','
+            << r.cycles.n << ',' << r.estimate << ',' << r.lower << ',' << r.upper << ',' << r.downtime << ','
+            << r.total_male << ',' << r.total_female << ',' << r.total_male_left << ',' << r.total_female_left << ','
+            << r.seconds << '\n';
+    }
+}
+
+#endif // __BATCH_H__
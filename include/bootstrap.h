@@ -0,0 +1,239 @@
+#ifndef __BOOTSTRAP_H__
+#define __BOOTSTRAP_H__
+
+// Resampling confidence intervals for regenerative ratio estimator r = sum(costs) / sum(clients)
+// computed over (cost, clients) pairs of cycles
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <omp.h>
+#include "statistics.h"
+#include "RngStream.h"
+
+
+using FP = double;
+
+
+struct Ratio_intervals
+{
+    FP estimate;
+    std::array<FP, 2> normal;      // Asymptotic normal interval
+    std::array<FP, 2> jackknife;
+    std::array<FP, 2> percentile;  // Bootstrap percentile interval
+    std::array<FP, 2> bca;         // Bootstrap bias-corrected and accelerated interval
+};
+
+
+// Sum of term(i) for i < n. Blocks of fixed size are summed in parallel and their sums are added in order,
+// so the result does not depend on the number of threads
+template <typename Term>
+FP fixed_order_sum(size_t n, Term term)
+{
+    const size_t block = 4096;
+    std::vector<FP> partial((n + block - 1) / block, 0);
+
+    #pragma omp parallel for
+    for (size_t b = 0; b < partial.size(); ++b)
+    {
+        FP sum = 0;
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); ++i)
+            sum += term(i);
+        partial[b] = sum;
+    }
+
+    FP sum = 0;
+    for (FP x : partial)
+        sum += x;
+    return sum;
+}
+
+
+// Jackknife of the ratio estimator in O(n): leaving out cycle i gives (C - c_i) / (A - a_i).
+// With fewer than 2 cycles, or a cycle that holds all clients, it is undefined and all fields are NaN
+struct Jackknife
+{
+    FP estimate = 0;  // Bias-corrected
+    FP standard_error = 0;
+    FP acceleration = 0;  // Used by BCa
+
+    Jackknife(const std::vector<FP>& costs, const std::vector<FP>& clients)
+    {
+        size_t n = costs.size();
+        FP sum_of_costs = fixed_order_sum(n, [&](size_t i) { return costs[i]; });
+        FP sum_of_clients = fixed_order_sum(n, [&](size_t i) { return clients[i]; });
+
+        bool defined = n >= 2;
+        for (size_t i = 0; defined && i < n; ++i)
+            defined = sum_of_clients - clients[i] != 0;
+        if (!defined)
+        {
+            estimate = standard_error = acceleration = NAN;
+            return;
+        }
+
+        FP full_estimate = sum_of_costs / sum_of_clients;
+        auto leave_one_out = [&](size_t i) { return (sum_of_costs - costs[i]) / (sum_of_clients - clients[i]); };
+        FP mean_of_leave_one_out = fixed_order_sum(n, leave_one_out) / n;
+
+        // Bias-corrected estimate
+        estimate = n * full_estimate - (n - 1) * mean_of_leave_one_out;
+
+        FP sum_of_squares = fixed_order_sum(n, [&](size_t i) { FP d = mean_of_leave_one_out - leave_one_out(i); return d * d; });
+        FP sum_of_cubes = fixed_order_sum(n, [&](size_t i) { FP d = mean_of_leave_one_out - leave_one_out(i); return d * d * d; });
+
+        standard_error = std::sqrt((n - 1.0) / n * sum_of_squares);
+        acceleration = sum_of_squares > 0 ? sum_of_cubes / (6 * std::pow(sum_of_squares, 1.5)) : 0;
+    }
+};
+
+
+// xoshiro256+ generator for resampling indices. Drawing 1e10 indices with RngStream costs minutes,
+// so every resample seeds this generator from its own RngStream substream instead
+class Index_generator
+{
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    Index_generator(RngStream& rng)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            uint64_t high = static_cast<uint64_t>(rng.RandU01() * 4294967296.0);
+            uint64_t low = static_cast<uint64_t>(rng.RandU01() * 4294967296.0);
+            s[i] = (high << 32) | low;
+        }
+    }
+
+    // Uniform index in [0, n) for n < 2^32 by multiply-shift of the upper 32 bits
+    uint32_t operator()(uint32_t n)
+    {
+        uint64_t result = s[0] + s[3];
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return static_cast<uint32_t>(((result >> 32) * n) >> 32);
+    }
+};
+
+
+// Ratio estimates of `resamples` bootstrap samples. Resample b is seeded from substream b of rng,
+// so the result does not depend on the number of threads
+std::vector<FP> bootstrap_replicates(const std::vector<FP>& costs, const std::vector<FP>& clients, size_t resamples, const RngStream& rng)
+{
+    const size_t n = costs.size();
+    const size_t chunk = 1024;
+    std::vector<FP> replicates(resamples);
+
+    // Cost and clients of a cycle are next to each other, so every random index touches one cache line
+    std::vector<std::array<FP, 2>> pairs(n);
+    for (size_t i = 0; i < n; ++i)
+        pairs[i] = {costs[i], clients[i]};
+
+    #pragma omp parallel
+    {
+        size_t threads = omp_get_num_threads();
+        size_t thread = omp_get_thread_num();
+        size_t begin = resamples * thread / threads;
+        size_t end = resamples * (thread + 1) / threads;
+
+        RngStream stream = rng;
+        stream.AdvanceSubstream(begin);
+
+        std::vector<uint32_t> indices(chunk);
+        for (size_t b = begin; b < end; ++b)
+        {
+            Index_generator next_index(stream);
+            FP sum_of_costs = 0, sum_of_clients = 0;
+            for (size_t first = 0; first < n; first += chunk)
+            {
+                size_t m = std::min(chunk, n - first);
+
+                // Draw indices first so the summation below is a plain gather loop the compiler can vectorize
+                for (size_t k = 0; k < m; ++k)
+                    indices[k] = next_index(static_cast<uint32_t>(n));
+
+                #pragma omp simd reduction(+:sum_of_costs, sum_of_clients)
+                for (size_t k = 0; k < m; ++k)
+                {
+                    sum_of_costs += pairs[indices[k]][0];
+                    sum_of_clients += pairs[indices[k]][1];
+                }
+            }
+            replicates[b] = sum_of_costs / sum_of_clients;
+            stream.ResetNextSubstream();
+        }
+    }
+
+    return replicates;
+}
+
+
+// Quantile of sorted data with linear interpolation
+FP sorted_quantile(const std::vector<FP>& sorted, FP p)
+{
+    FP position = std::clamp(p, FP(0), FP(1)) * (sorted.size() - 1);
+    size_t i = static_cast<size_t>(position);
+    if (i + 1 >= sorted.size())
+        return sorted.back();
+    return sorted[i] + (position - i) * (sorted[i + 1] - sorted[i]);
+}
+
+
+// Normal, jackknife, bootstrap percentile and BCa intervals for the ratio estimator.
+// With resamples = 0 only normal and jackknife intervals are computed
+Ratio_intervals ratio_intervals(const std::vector<FP>& costs, const std::vector<FP>& clients, FP confidence_level = 0.95,
+                                size_t resamples = 10000, RngStream rng = RngStream())
+{
+    Ratio_intervals result;
+    FP alpha = 1 - confidence_level;
+    FP z = inverse_standard_normal(1 - alpha / 2);
+
+    Regenerative_accumulator accumulator;
+    for (size_t i = 0; i < costs.size(); ++i)
+        accumulator.add(costs[i], clients[i]);
+    result.estimate = accumulator.value();
+    result.normal = accumulator.confidence_interval(confidence_level);
+
+    Jackknife jackknife(costs, clients);
+    result.jackknife = {jackknife.estimate - z * jackknife.standard_error, jackknife.estimate + z * jackknife.standard_error};
+
+    if (resamples == 0)
+    {
+        result.percentile = result.bca = {NAN, NAN};
+        return result;
+    }
+
+    std::vector<FP> replicates = bootstrap_replicates(costs, clients, resamples, rng);
+    std::sort(replicates.begin(), replicates.end());
+
+    result.percentile = {sorted_quantile(replicates, alpha / 2), sorted_quantile(replicates, 1 - alpha / 2)};
+
+    // Bias correction from the fraction of replicates below the estimate
+    FP below = std::lower_bound(replicates.begin(), replicates.end(), result.estimate) - replicates.begin();
+    FP fraction = std::clamp(below / resamples, FP(0.5) / resamples, 1 - FP(0.5) / resamples);
+    FP z0 = inverse_standard_normal(fraction);
+    FP a = jackknife.acceleration;
+
+    auto adjusted = [z0, a](FP z_level)
+    {
+        FP w = z0 + z_level;
+        return standard_normal_cdf(z0 + w / (1 - a * w));
+    };
+    result.bca = {sorted_quantile(replicates, adjusted(-z)), sorted_quantile(replicates, adjusted(z))};
+
+    return result;
+}
+
+#endif // __BOOTSTRAP_H__
@@ -0,0 +1,567 @@
+#ifndef __DISTRIBUTIONS_H__
+#define __DISTRIBUTIONS_H__
+
+#include <vector>
+#include <cmath>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include "statistics.h"
+#include "RngStream.h"
+
+
+using FP = double;
+
+
+// Tables of Marsaglia-Tsang ziggurat for standard exponential distribution with 256 layers.
+// Layer index is taken from the low 8 bits of a 32-bit uniform and the position inside the layer from the other 24 bits.
+// Tables are computed in FP and stored in Real
+template <typename Real>
+struct Ziggurat_tables
+{
+    static constexpr FP r = 7.697117470131487;          // Start of the tail
+    static constexpr FP v = 3.949659822581572e-3;       // Area of each layer
+    static constexpr FP scale = 16777216.0;             // 2^24
+
+    uint32_t k[256];
+    Real w[256];
+    Real f[256];
+
+    Ziggurat_tables()
+    {
+        FP d = r, previous_d = r;
+        FP q = v / std::exp(-d);
+
+        k[0] = static_cast<uint32_t>((d / q) * scale);
+        k[1] = 0;
+        w[0] = q / scale;
+        w[255] = d / scale;
+        f[0] = 1;
+        f[255] = std::exp(-d);
+
+        for (size_t i = 254; i >= 1; --i)
+        {
+            d = -std::log(v / d + std::exp(-d));
+            k[i + 1] = static_cast<uint32_t>((d / previous_d) * scale);
+            previous_d = d;
+            f[i] = std::exp(-d);
+            w[i] = d / scale;
+        }
+    }
+};
+
+template <typename Real>
+const Ziggurat_tables<Real> ziggurat_tables;
+
+// Rest of the ziggurat after the first uniform missed the rectangle of layer i at position j.
+// uniform() returns the next uniform of the stream.
+// Position 0 would give time 0, which State takes for a stopped service clock, so it is drawn again
+template <typename Real, typename Uniform>
+Real ziggurat_exponential_slow(uint32_t j, size_t i, Uniform&& uniform)
+{
+    const Ziggurat_tables<Real>& z = ziggurat_tables<Real>;
+
+    for (;;)
+    {
+        if (j != 0)
+        {
+            // Base layer: sample from the tail beyond r
+            if (i == 0)
+                return Real(Ziggurat_tables<Real>::r - std::log(uniform()));
+
+            // Wedge between the layer rectangle and the density
+            Real x = j * z.w[i];
+            if (z.f[i] + Real(uniform()) * (z.f[i - 1] - z.f[i]) < std::exp(-x))
+                return x;
+        }
+
+        j = static_cast<uint32_t>(uniform() * 4294967296.0);
+        i = j & 255;
+        j >>= 8;
+        if (j != 0 && j < z.k[i])
+            return j * z.w[i];
+    }
+}
+
+// Standard exponential variate from uniforms of uniform(), always positive;
+// about 99% of calls cost one uniform, two comparisons and one multiplication
+template <typename Real, typename Uniform>
+Real ziggurat_exponential(Uniform&& uniform)
+{
+    const Ziggurat_tables<Real>& z = ziggurat_tables<Real>;
+
+    uint32_t j = static_cast<uint32_t>(uniform() * 4294967296.0);
+    size_t i = j & 255;
+    j >>= 8;
+    if (j != 0 && j < z.k[i])
+        return j * z.w[i];
+    return ziggurat_exponential_slow<Real>(j, i, uniform);
+}
+
+template <typename Real = FP>
+Real ziggurat_exponential(RngStream& rng)
+{
+    return ziggurat_exponential<Real>([&rng]() { return rng.RandU01(); });
+}
+
+enum class Exponential_sampler
+{
+    INVERSION,  // -log(u) / lambda
+    ZIGGURAT
+};
+
+Exponential_sampler exponential_sampler = Exponential_sampler::ZIGGURAT;
+
+// Variate is computed in Real (float or FP)
+template <typename Real = FP>
+Real generate_exponential(FP lambda, RngStream& rng)
+{
+    if (exponential_sampler == Exponential_sampler::ZIGGURAT)
+        return ziggurat_exponential<Real>(rng) / Real(lambda);
+
+    // Logarithm in FP: u rounded to float may be 1 and give zero time
+    return Real(-std::log(rng.RandU01())) / Real(lambda);
+}
+
+// Finds x such that cdf(x) = u by bisection. cdf must be nondecreasing on [0, +inf)
+FP invert_cdf(const std::function<FP(FP)>& cdf, FP u, FP scale)
+{
+    FP lo = 0, hi = scale;
+    while (cdf(hi) < u)
+    {
+        lo = hi;
+        hi *= 2;
+    }
+
+    for (size_t i = 0; i < 100 && hi - lo > 1e-12 * hi; ++i)
+    {
+        FP mid = (lo + hi) / 2;
+        if (cdf(mid) < u) lo = mid;
+        else hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+
+// Walker's alias table: sampling from discrete distribution in O(1) with one uniform
+class Alias_table
+{
+    std::vector<FP> probability;
+    std::vector<size_t> alias;
+
+public:
+    Alias_table() = default;
+
+    Alias_table(const std::vector<FP>& weights): probability(weights.size()), alias(weights.size())
+    {
+        size_t n = weights.size();
+        FP total = std::accumulate(weights.begin(), weights.end(), FP(0));
+
+        std::vector<FP> scaled(n);
+        std::vector<size_t> small, large;
+        for (size_t i = 0; i < n; ++i)
+        {
+            scaled[i] = weights[i] * n / total;
+            if (scaled[i] < 1) small.push_back(i);
+            else large.push_back(i);
+        }
+
+        while (!small.empty() && !large.empty())
+        {
+            size_t s = small.back(); small.pop_back();
+            size_t l = large.back(); large.pop_back();
+
+            probability[s] = scaled[s];
+            alias[s] = l;
+
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1) small.push_back(l);
+            else large.push_back(l);
+        }
+
+        // Remaining columns are full up to rounding errors
+        for (size_t i : large) { probability[i] = 1; alias[i] = i; }
+        for (size_t i : small) { probability[i] = 1; alias[i] = i; }
+    }
+
+    size_t sample(RngStream& rng) const
+    {
+        // Integer part of u * n selects the column, fractional part decides between column and its alias
+        FP u = rng.RandU01() * probability.size();
+        size_t column = static_cast<size_t>(u);
+        return (u - column < probability[column]) ? column : alias[column];
+    }
+
+    size_t size() const
+    {
+        return probability.size();
+    }
+};
+
+
+// Inverse CDF tabulated on a uniform grid of u and linearly interpolated between nodes.
+// Quantile function is unbounded near 0 and 1 for most distributions, so outer cells use exact quantile
+class Quantile_table
+{
+    static constexpr size_t cells = 4096;
+
+    std::vector<FP> nodes;
+    std::function<FP(FP)> quantile;
+
+public:
+    Quantile_table() = default;
+
+    Quantile_table(std::function<FP(FP)> quantile): nodes(cells + 1), quantile(quantile)
+    {
+        for (size_t i = 1; i < cells; ++i)
+            nodes[i] = quantile(FP(i) / cells);
+    }
+
+    FP operator()(FP u) const
+    {
+        FP position = u * cells;
+        size_t i = static_cast<size_t>(position);
+        if (i == 0 || i >= cells - 1)
+            return quantile(u);
+
+        FP frac = position - i;
+        return nodes[i] + frac * (nodes[i + 1] - nodes[i]);
+    }
+};
+
+
+// Distribution of time between events of one clock
+class Distribution
+{
+public:
+    enum Kind
+    {
+        EXPONENTIAL,
+        ERLANG,
+        HYPEREXPONENTIAL,
+        LOGNORMAL,
+        EMPIRICAL
+    };
+
+private:
+    Kind kind = EXPONENTIAL;
+    FP rate = 1;
+    FP mean_value = 1;
+
+    std::vector<FP> phase_rates;
+    Alias_table phases;
+    Quantile_table table;
+
+public:
+    static Distribution exponential(FP rate)
+    {
+        Distribution d;
+        d.kind = EXPONENTIAL;
+        d.rate = rate;
+        d.mean_value = 1 / rate;
+        return d;
+    }
+
+    // Sum of k exponentials with parameter rate
+    static Distribution erlang(size_t k, FP rate)
+    {
+        Distribution d;
+        d.kind = ERLANG;
+        d.rate = rate;
+        d.mean_value = k / rate;
+
+        auto cdf = [k](FP x)
+        {
+            FP term = 1, sum = 1;
+            for (size_t n = 1; n < k; ++n)
+            {
+                term *= x / n;
+                sum += term;
+            }
+            return 1 - std::exp(-x) * sum;
+        };
+        d.table = Quantile_table([cdf, k, rate](FP u) { return invert_cdf(cdf, u, FP(k)) / rate; });
+        return d;
+    }
+
+    // Mixture of exponentials: with probability probabilities[i] the time is exponential with rates[i]
+    static Distribution hyperexponential(const std::vector<FP>& probabilities, const std::vector<FP>& rates)
+    {
+        if (probabilities.size() != rates.size() || rates.empty())
+            throw std::invalid_argument("hyperexponential: probabilities and rates must have the same nonzero size");
+
+        Distribution d;
+        d.kind = HYPEREXPONENTIAL;
+        d.phase_rates = rates;
+        d.phases = Alias_table(probabilities);
+
+        FP total = std::accumulate(probabilities.begin(), probabilities.end(), FP(0));
+        d.mean_value = 0;
+        for (size_t i = 0; i < rates.size(); ++i)
+            d.mean_value += probabilities[i] / total / rates[i];
+        d.rate = 1 / d.mean_value;
+        return d;
+    }
+
+    // exp(N(mu, sigma^2))
+    static Distribution lognormal(FP mu, FP sigma)
+    {
+        Distribution d;
+        d.kind = LOGNORMAL;
+        d.mean_value = std::exp(mu + sigma * sigma / 2);
+        d.rate = 1 / d.mean_value;
+        d.table = Quantile_table([mu, sigma](FP u) { return std::exp(mu + sigma * inverse_standard_normal(u)); });
+        return d;
+    }
+
+    // Piecewise linear interpolation of empirical CDF of observed times
+    static Distribution empirical(std::vector<FP> data)
+    {
+        if (data.empty())
+            throw std::invalid_argument("empirical: no data");
+
+        std::sort(data.begin(), data.end());
+
+        Distribution d;
+        d.kind = EMPIRICAL;
+        // Quantile function is linear between adjacent order statistics, and each of the
+        // n - 1 pieces has probability 1 / (n - 1), so the mean is the average of their midpoints
+        d.mean_value = data[0];
+        if (data.size() > 1)
+        {
+            FP midpoints = 0;
+            for (size_t i = 0; i + 1 < data.size(); ++i)
+                midpoints += (data[i] + data[i + 1]) / 2;
+            d.mean_value = midpoints / (data.size() - 1);
+        }
+        d.rate = 1 / d.mean_value;
+        d.table = Quantile_table([data](FP u)
+        {
+            FP position = u * (data.size() - 1);
+            size_t i = std::min(static_cast<size_t>(position), data.size() - 1);
+            if (i + 1 == data.size())
+                return data[i];
+            return data[i] + (position - i) * (data[i + 1] - data[i]);
+        });
+        return d;
+    }
+
+    // Reads whitespace separated observed times from file
+    static Distribution empirical_from_file(const std::string& path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error("empirical_from_file: cannot open " + path);
+
+        std::vector<FP> data;
+        FP x;
+        while (in >> x)
+            data.push_back(x);
+        return empirical(data);
+    }
+
+    template <typename Real = FP>
+    Real sample(RngStream& rng) const
+    {
+        switch (kind)
+        {
+        case EXPONENTIAL:
+            return generate_exponential<Real>(rate, rng);
+        case HYPEREXPONENTIAL:
+            return generate_exponential<Real>(phase_rates[phases.sample(rng)], rng);
+        default:
+            return Real(table(rng.RandU01()));
+        }
+    }
+
+    FP mean() const
+    {
+        return mean_value;
+    }
+
+    // Rate of exponential distribution
+    FP get_rate() const
+    {
+        return rate;
+    }
+
+    Kind get_kind() const
+    {
+        return kind;
+    }
+
+    bool is_memoryless() const
+    {
+        return kind == EXPONENTIAL;
+    }
+};
+
+
+// Periodic arrival rate of nonhomogeneous Poisson process, piecewise constant or piecewise linear.
+// Arrivals are sampled by thinning with a piecewise constant majorant: the period is divided into cells,
+// each with its own maximum rate, so rejected candidates stay rare even for large peak-to-trough ratios
+class Rate_function
+{
+    // On [start, end) rate is a + slope * (t - start) <= majorant
+    struct Cell
+    {
+        FP start;
+        FP end;
+        FP a;
+        FP slope;
+        FP majorant;
+    };
+
+    std::vector<Cell> cells;
+    std::vector<FP> cell_starts;
+    FP period_value = 0;
+    FP mean_value = 0;
+
+    // Linear pieces are split until majorant exceeds the rate by at most this fraction
+    static constexpr FP majorant_tolerance = 0.05;
+
+public:
+    // rates[i] on [breakpoints[i], breakpoints[i + 1]); breakpoints start at 0 and the last one is the period
+    static Rate_function piecewise_constant(const std::vector<FP>& breakpoints, const std::vector<FP>& rates)
+    {
+        if (breakpoints.size() != rates.size() + 1 || rates.empty())
+            throw std::invalid_argument("piecewise_constant: need one more breakpoint than rates");
+
+        Rate_function f;
+        for (size_t i = 0; i < rates.size(); ++i)
+            f.cells.push_back({breakpoints[i], breakpoints[i + 1], rates[i], 0, rates[i]});
+        f.finish(breakpoints.back());
+        return f;
+    }
+
+    // Rate is rates[i] at breakpoints[i] and linear between them; breakpoints start at 0 and the last one is the period
+    static Rate_function piecewise_linear(const std::vector<FP>& breakpoints, const std::vector<FP>& rates)
+    {
+        if (breakpoints.size() != rates.size() || rates.size() < 2)
+            throw std::invalid_argument("piecewise_linear: need a rate for every breakpoint");
+
+        Rate_function f;
+        for (size_t i = 0; i + 1 < rates.size(); ++i)
+        {
+            FP length = breakpoints[i + 1] - breakpoints[i];
+            FP slope = (rates[i + 1] - rates[i]) / length;
+            FP top = std::max(rates[i], rates[i + 1]);
+
+            size_t pieces = 1;
+            if (top > 0)
+                pieces = std::min(size_t(1024), std::max(size_t(1), size_t(std::ceil(std::abs(rates[i + 1] - rates[i]) / (majorant_tolerance * top)))));
+
+            for (size_t j = 0; j < pieces; ++j)
+            {
+                FP start = breakpoints[i] + length * j / pieces;
+                FP end = (j + 1 == pieces) ? breakpoints[i + 1] : breakpoints[i] + length * (j + 1) / pieces;
+                FP a = rates[i] + slope * (start - breakpoints[i]);
+                FP b = rates[i] + slope * (end - breakpoints[i]);
+                f.cells.push_back({start, end, a, slope, std::max(a, b)});
+            }
+        }
+        f.finish(breakpoints.back());
+        return f;
+    }
+
+    bool empty() const
+    {
+        return cells.empty();
+    }
+
+    FP period() const
+    {
+        return period_value;
+    }
+
+    // Average rate over the period
+    FP mean() const
+    {
+        return mean_value;
+    }
+
+    FP operator()(FP t) const
+    {
+        FP phase = std::fmod(t, period_value);
+        const Cell& cell = cells[find_cell(phase)];
+        return cell.a + cell.slope * (phase - cell.start);
+    }
+
+    // Time of the first arrival after t
+    FP next_arrival(FP t, RngStream& rng) const
+    {
+        FP phase = std::fmod(t, period_value);
+        FP base = t - phase;
+        size_t k = find_cell(phase);
+
+        for (;;)
+        {
+            const Cell& cell = cells[k];
+            if (cell.majorant > 0)
+            {
+                phase += generate_exponential(cell.majorant, rng);
+                if (phase < cell.end)
+                {
+                    if (cell.slope == 0 || rng.RandU01() * cell.majorant <= cell.a + cell.slope * (phase - cell.start))
+                        return base + phase;
+                    continue;
+                }
+            }
+
+            // No accepted candidate in this cell: by memorylessness continue from its end with the next majorant
+            if (++k == cells.size())
+            {
+                k = 0;
+                base += period_value;
+            }
+            phase = cells[k].start;
+        }
+    }
+
+private:
+    void finish(FP period)
+    {
+        period_value = period;
+        FP integral = 0;
+        for (const Cell& cell : cells)
+        {
+            FP length = cell.end - cell.start;
+            integral += (cell.a + cell.slope * length / 2) * length;
+            cell_starts.push_back(cell.start);
+        }
+        mean_value = integral / period;
+
+        if (!(mean_value > 0))
+            throw std::invalid_argument("Rate_function: rate must be positive somewhere in the period");
+    }
+
+    size_t find_cell(FP phase) const
+    {
+        size_t k = std::upper_bound(cell_starts.begin(), cell_starts.end(), phase) - cell_starts.begin();
+        return k == 0 ? 0 : k - 1;
+    }
+};
+
+
+// Compares n variates of generate_exponential with exact exponential distribution by Kolmogorov-Smirnov test
+void validate_exponential_sampler(FP lambda, size_t n, FP significance_level = 0.01)
+{
+    RngStream rng;
+    std::vector<FP> sample(n);
+    for (size_t i = 0; i < n; ++i)
+        sample[i] = generate_exponential(lambda, rng);
+
+    FP d = kolmogorov_smirnov_statistic(sample, [lambda](FP x) { return 1 - std::exp(-lambda * x); });
+    FP p_value = kolmogorov_p_value(d, n);
+
+    std::cout << "Sampler: " << (exponential_sampler == Exponential_sampler::ZIGGURAT ? "ziggurat" : "inversion") << "\n";
+    std::cout << "Mean: " << mean(sample) << ", expected: " << 1 / lambda << "\n";
+    std::cout << "KS statistic: " << d << ", p-value: " << p_value << "\n";
+    std::cout << (p_value < significance_level ? "REJECTED" : "Passed") << " at significance level " << significance_level << "\n";
+}
+
+#endif // __DISTRIBUTIONS_H__
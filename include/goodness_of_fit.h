@@ -0,0 +1,294 @@
+#ifndef __GOODNESS_OF_FIT_H__
+#define __GOODNESS_OF_FIT_H__
+
+// Goodness-of-fit tests of exponential samples that never keep the samples themselves.
+// Every sample x is mapped to u = F(x) = 1 - exp(-rate * x), which is uniform on [0, 1) if x is exponential,
+// and counted in one of `bins` equal bins. Summaries of different threads and runs are merged by adding counts.
+// KS statistic is exact at bin edges, so it is at most 1 / bins below the statistic of raw data;
+// Anderson-Darling spreads samples of a bin uniformly over it
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include "statistics.h"
+
+
+using FP = double;
+
+
+class Exponential_summary
+{
+    FP rate = 0;
+    std::vector<uint64_t> counts;
+    uint64_t n = 0;
+    FP sum = 0;
+    FP sum_of_squares = 0;
+
+public:
+    Exponential_summary() = default;
+
+    Exponential_summary(FP rate, size_t bins = 1 << 18): rate(rate), counts(bins, 0) {}
+
+    bool empty() const
+    {
+        return counts.empty();
+    }
+
+    void add(FP x)
+    {
+        FP u = -std::expm1(-rate * x);
+        size_t bin = std::min(static_cast<size_t>(u * counts.size()), counts.size() - 1);
+        ++counts[bin];
+        ++n;
+        sum += x;
+        sum_of_squares += x * x;
+    }
+
+    // Summaries must have the same rate and number of bins
+    void merge(const Exponential_summary& other)
+    {
+        if (counts.empty())
+        {
+            *this = other;
+            return;
+        }
+        for (size_t i = 0; i < counts.size(); ++i)
+            counts[i] += other.counts[i];
+        n += other.n;
+        sum += other.sum;
+        sum_of_squares += other.sum_of_squares;
+    }
+
+    uint64_t count() const
+    {
+        return n;
+    }
+
+    FP get_rate() const
+    {
+        return rate;
+    }
+
+    const std::vector<uint64_t>& get_counts() const
+    {
+        return counts;
+    }
+
+    FP mean() const
+    {
+        return sum / n;
+    }
+
+    FP variance() const
+    {
+        return (sum_of_squares - sum * sum / n) / (n - 1);
+    }
+
+    void write(std::ostream& out) const
+    {
+        uint64_t bins = counts.size();
+        out.write(reinterpret_cast<const char*>(&rate), sizeof(rate));
+        out.write(reinterpret_cast<const char*>(&bins), sizeof(bins));
+        out.write(reinterpret_cast<const char*>(counts.data()), bins * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+        out.write(reinterpret_cast<const char*>(&sum_of_squares), sizeof(sum_of_squares));
+    }
+
+    void read(std::istream& in)
+    {
+        uint64_t bins = 0;
+        in.read(reinterpret_cast<char*>(&rate), sizeof(rate));
+        in.read(reinterpret_cast<char*>(&bins), sizeof(bins));
+        if (!in)
+            return;
+        counts.resize(bins);
+        in.read(reinterpret_cast<char*>(counts.data()), bins * sizeof(uint64_t));
+        in.read(reinterpret_cast<char*>(&n), sizeof(n));
+        in.read(reinterpret_cast<char*>(&sum), sizeof(sum));
+        in.read(reinterpret_cast<char*>(&sum_of_squares), sizeof(sum_of_squares));
+    }
+};
+
+
+// Regularized upper incomplete gamma function Q(a, x) (series for x < a + 1, continued fraction otherwise)
+FP regularized_gamma_q(FP a, FP x)
+{
+    if (x <= 0)
+        return 1;
+
+    FP log_prefactor = -x + a * std::log(x) - std::lgamma(a);
+    if (x < a + 1)
+    {
+        FP term = 1 / a, sum = term;
+        for (int k = 1; k < 100000; ++k)
+        {
+            term *= x / (a + k);
+            sum += term;
+            if (term < sum * 1e-15)
+                break;
+        }
+        return std::clamp(1 - sum * std::exp(log_prefactor), FP(0), FP(1));
+    }
+
+    // Modified Lentz's method
+    const FP tiny = 1e-300;
+    FP b = x + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+    for (int k = 1; k < 100000; ++k)
+    {
+        FP an = -k * (k - a);
+        b += 2;
+        d = an * d + b;
+        if (std::abs(d) < tiny) d = tiny;
+        c = b + an / c;
+        if (std::abs(c) < tiny) c = tiny;
+        d = 1 / d;
+        FP delta = d * c;
+        h *= delta;
+        if (std::abs(delta - 1) < 1e-15)
+            break;
+    }
+    return std::clamp(std::exp(log_prefactor) * h, FP(0), FP(1));
+}
+
+FP chi_square_p_value(FP x, size_t degrees_of_freedom)
+{
+    return regularized_gamma_q(degrees_of_freedom / 2.0, x / 2);
+}
+
+// Asymptotic p-value of Anderson-Darling statistic (Marsaglia & Marsaglia, 2004)
+FP anderson_darling_p_value(FP z)
+{
+    FP cdf;
+    if (z <= 0)
+        cdf = 0;
+    else if (z < 2)
+        cdf = std::exp(-1.2337141 / z) / std::sqrt(z) *
+              (2.00012 + (0.247105 - (0.0649821 - (0.0347962 - (0.011672 - 0.00168691 * z) * z) * z) * z) * z);
+    else
+        cdf = std::exp(-std::exp(1.0776 - (2.30695 - (0.43424 - (0.082433 - (0.008056 - 0.0003146 * z) * z) * z) * z) * z));
+    return std::clamp(1 - cdf, FP(0), FP(1));
+}
+
+
+struct Fit_test
+{
+    FP statistic = 0;
+    FP p_value = 1;
+};
+
+struct Fit_report
+{
+    uint64_t n = 0;
+    FP mean = 0;
+    FP expected_mean = 0;
+    std::array<FP, 2> mean_interval{0, 0};  // 95% interval of the mean
+    Fit_test kolmogorov_smirnov;
+    Fit_test anderson_darling;
+    Fit_test chi_square;
+    size_t chi_square_groups = 0;
+
+    bool passed(FP significance) const
+    {
+        return kolmogorov_smirnov.p_value >= significance && anderson_darling.p_value >= significance &&
+               chi_square.p_value >= significance;
+    }
+
+    void print(const std::string& name) const
+    {
+        std::cout << name << ": n = " << n << ", mean " << mean << " (expected " << expected_mean
+                  << ", 95% CI [" << mean_interval[0] << ", " << mean_interval[1] << "])\n";
+        std::cout << "\tKS\t\tD = " << kolmogorov_smirnov.statistic << "\tp = " << kolmogorov_smirnov.p_value << '\n';
+        std::cout << "\tAnderson-Darling\tA2 = " << anderson_darling.statistic << "\tp = " << anderson_darling.p_value << '\n';
+        std::cout << "\tChi-square\tX2 = " << chi_square.statistic << " (" << chi_square_groups - 1 << " df)\tp = "
+                  << chi_square.p_value << '\n';
+    }
+};
+
+
+Fit_test kolmogorov_smirnov_test(const Exponential_summary& summary)
+{
+    const std::vector<uint64_t>& counts = summary.get_counts();
+    FP n = FP(summary.count());
+    FP bins = FP(counts.size());
+
+    FP d = 0;
+    uint64_t below = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        below += counts[i];
+        d = std::max(d, std::abs(below / n - (i + 1) / bins));
+    }
+    return {d, kolmogorov_p_value(d, summary.count())};
+}
+
+// A2 = -n - 1/n * sum (2i - 1) * [ln u_(i) + ln(1 - u_(n+1-i))]; samples of bin [a, b) with ranks r + 1 .. r + c
+// add c * (2r + c) * avg(ln u) + c * (2n - 2r - c) * avg(ln(1 - u)) with averages over the bin
+Fit_test anderson_darling_test(const Exponential_summary& summary)
+{
+    const std::vector<uint64_t>& counts = summary.get_counts();
+    long double n = summary.count();
+    size_t bins = counts.size();
+
+    // Integral of ln u from 0 to x
+    auto log_integral = [](long double x) { return x > 0 ? x * std::log(x) - x : 0.0L; };
+    auto average_log = [&](long double a, long double b) { return (log_integral(b) - log_integral(a)) / (b - a); };
+
+    long double sum = 0, r = 0;
+    for (size_t i = 0; i < bins; ++i)
+    {
+        if (counts[i] == 0)
+            continue;
+        long double c = counts[i];
+        long double a = (long double)i / bins, b = (long double)(i + 1) / bins;
+        sum += c * (2 * r + c) * average_log(a, b) + c * (2 * n - 2 * r - c) * average_log(1 - b, 1 - a);
+        r += c;
+    }
+    FP a2 = FP(-n - sum / n);
+    return {a2, anderson_darling_p_value(a2)};
+}
+
+// Bins are joined into about 2 * n^(2/5) groups of equal probability (Mann-Wald), at least 5 expected samples each
+Fit_test chi_square_test(const Exponential_summary& summary, size_t& groups)
+{
+    const std::vector<uint64_t>& counts = summary.get_counts();
+    FP n = FP(summary.count());
+    size_t bins = counts.size();
+    groups = std::clamp<size_t>(static_cast<size_t>(2 * std::pow(n, 0.4)), 2, std::max<size_t>(2, std::min<size_t>(bins, static_cast<size_t>(n / 5))));
+
+    FP x2 = 0;
+    for (size_t g = 0; g < groups; ++g)
+    {
+        size_t begin = g * bins / groups, end = (g + 1) * bins / groups;
+        FP observed = 0;
+        for (size_t i = begin; i < end; ++i)
+            observed += counts[i];
+        FP expected = n * (end - begin) / bins;
+        x2 += (observed - expected) * (observed - expected) / expected;
+    }
+    return {x2, chi_square_p_value(x2, groups - 1)};
+}
+
+Fit_report goodness_of_fit(const Exponential_summary& summary)
+{
+    Fit_report report;
+    report.n = summary.count();
+    if (report.n < 2)
+        return report;
+
+    report.mean = summary.mean();
+    report.expected_mean = 1 / summary.get_rate();
+    FP margin = 1.96 * std::sqrt(summary.variance() / report.n);
+    report.mean_interval = {report.mean - margin, report.mean + margin};
+
+    report.kolmogorov_smirnov = kolmogorov_smirnov_test(summary);
+    report.anderson_darling = anderson_darling_test(summary);
+    report.chi_square = chi_square_test(summary, report.chi_square_groups);
+    return report;
+}
+
+#endif // __GOODNESS_OF_FIT_H__
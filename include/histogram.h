@@ -0,0 +1,121 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <iostream>
+
+
+using FP = double;
+
+
+// Flat histogram over states (male, female, served) with bounded memory.
+// Values above limits of a dimension go to its last bin. Histograms with the same limits can be merged
+class State_histogram
+{
+    std::array<size_t, 3> limits{0, 0, 0};
+    std::vector<FP> weights{0};
+
+public:
+    State_histogram() = default;
+
+    State_histogram(size_t male_limit, size_t female_limit, size_t served_limit):
+        limits{male_limit, female_limit, served_limit},
+        weights((male_limit + 1) * (female_limit + 1) * (served_limit + 1), 0) {}
+
+    size_t index(const std::array<size_t, 3>& state) const
+    {
+        size_t male = std::min(state[0], limits[0]);
+        size_t female = std::min(state[1], limits[1]);
+        size_t served = std::min(state[2], limits[2]);
+        return (male * (limits[1] + 1) + female) * (limits[2] + 1) + served;
+    }
+
+    void add(const std::array<size_t, 3>& state, FP weight = 1)
+    {
+        weights[index(state)] += weight;
+    }
+
+    void merge(const State_histogram& other)
+    {
+        for (size_t i = 0; i < weights.size(); ++i)
+            weights[i] += other.weights[i];
+    }
+
+    FP operator()(size_t male, size_t female, size_t served) const
+    {
+        return weights[index({male, female, served})];
+    }
+
+    const std::array<size_t, 3>& get_limits() const
+    {
+        return limits;
+    }
+
+    const std::vector<FP>& get_weights() const
+    {
+        return weights;
+    }
+
+    std::vector<FP>& get_weights()
+    {
+        return weights;
+    }
+
+    FP total() const
+    {
+        FP sum = 0;
+        for (FP w : weights)
+            sum += w;
+        return sum;
+    }
+
+    // Normalized distribution of one coordinate (0 - male, 1 - female, 2 - served)
+    std::vector<FP> marginal(size_t dimension) const
+    {
+        std::vector<FP> result(limits[dimension] + 1, 0);
+        FP sum = total();
+        for (size_t male = 0; male <= limits[0]; ++male)
+            for (size_t female = 0; female <= limits[1]; ++female)
+                for (size_t served = 0; served <= limits[2]; ++served)
+                {
+                    std::array<size_t, 3> state{male, female, served};
+                    result[state[dimension]] += weights[index(state)] / sum;
+                }
+        return result;
+    }
+
+    // Mean of one coordinate; values in the last bin are counted as the limit
+    FP mean(size_t dimension) const
+    {
+        std::vector<FP> p = marginal(dimension);
+        FP result = 0;
+        for (size_t i = 0; i < p.size(); ++i)
+            result += i * p[i];
+        return result;
+    }
+};
+
+
+// Distributions of the state at fixed time points over many replications
+struct Transient_result
+{
+    std::vector<FP> grid;
+    std::vector<State_histogram> histograms;  // histograms[i] is the distribution at time grid[i]
+
+    void print() const
+    {
+        std::cout << "\n========= TRANSIENT =========\n";
+        std::cout << "Time\tMale\tFemale\tServed\tP(empty)\n";
+        for (size_t i = 0; i < grid.size(); ++i)
+        {
+            const State_histogram& h = histograms[i];
+            std::cout << grid[i] << '\t' << h.mean(0) << '\t' << h.mean(1) << '\t' << h.mean(2) << '\t'
+                      << h(0, 0, 0) / h.total() << '\n';
+        }
+        std::cout << "=============================\n";
+    }
+};
+
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,630 @@
+#ifndef __LOCKSTEP_H__
+#define __LOCKSTEP_H__
+
+// Replications of one system advanced together in lanes. Clocks, states, streams and accumulators of
+// `Lanes` replications are stored in arrays indexed by lane, and every step of the event loop is a loop
+// over lanes without branches (omp simd): next event is selected with compares and blends, the conductor
+// and the cost are looked up in tables, and clocks are sampled for the lanes that need them under a mask.
+// A lane whose run has ended takes the next replication, so lanes do not wait for the longest run.
+// Every replication gives the same statistics as run<COLLECT_ESTIMATOR> with the same stream.
+// Supported systems have exponential clocks with constant rates, a transition table (finite queue limits)
+// and cost linear in time; other systems are run by run<COLLECT_ESTIMATOR>
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "system.h"
+
+
+using FP = double;
+
+
+// a where mask is 1 and b where it is 0. Values are chosen by their bits, so the choice is exact,
+// takes no branch and vectorizes whatever the widths of mask and values are
+template <typename Real>
+inline Real blend(uint32_t mask, Real a, Real b)
+{
+    using Bits = std::conditional_t<sizeof(Real) == 8, uint64_t, uint32_t>;
+    Bits x, y;
+    std::memcpy(&x, &a, sizeof(Real));
+    std::memcpy(&y, &b, sizeof(Real));
+    Bits m = Bits(0) - Bits(mask);
+    Bits bits = (x & m) | (y & ~m);
+    Real result;
+    std::memcpy(&result, &bits, sizeof(Real));
+    return result;
+}
+
+
+// MRG32k3a streams (RngStream without antithetic and increased precision variates) of all lanes.
+// Numbers are generated for all lanes at once, Block per lane, and handed out in order, so the sequence
+// of every lane is exactly that of its RngStream. Conditional steps of RngStream::U01 are written as
+// exact arithmetic on integers stored in FP, which the compiler vectorizes without branches
+template <size_t Lanes, size_t Block = 64>
+class Lane_streams
+{
+    static constexpr FP m1 = 4294967087.0;
+    static constexpr FP m2 = 4294944443.0;
+    static constexpr FP norm = 1.0 / (m1 + 1.0);
+    static constexpr FP a12 = 1403580.0;
+    static constexpr FP a13n = 810728.0;
+    static constexpr FP a21 = 527612.0;
+    static constexpr FP a23n = 1370589.0;
+
+    alignas(64) FP s[6][Lanes];
+    alignas(64) FP buffer[Block + 1][Lanes];  // Uniforms / norm; row Block is read by lanes that do not draw
+    alignas(64) uint32_t cursor[Lanes];       // Next unused row of the lane, Block if none is left
+
+public:
+    Lane_streams()
+    {
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            for (size_t k = 0; k < 6; ++k)
+                s[k][l] = 12345;
+            for (size_t k = 0; k < Block; ++k)
+                buffer[k][l] = 0;  // Blends in refill read every row, they must be finite
+            buffer[Block][l] = 1;
+            cursor[l] = Block;
+        }
+    }
+
+    // Lane continues from the current state of rng
+    void load(size_t lane, const RngStream& rng)
+    {
+        unsigned long seed[6];
+        rng.GetState(seed);
+        for (size_t k = 0; k < 6; ++k)
+            s[k][lane] = FP(seed[k]);
+        cursor[lane] = Block;
+    }
+
+    FP next(size_t lane)
+    {
+        if (cursor[lane] == Block)
+            refill();
+        return buffer[cursor[lane]++][lane] * norm;
+    }
+
+    // Next uniform of every lane with mask set
+    void next(const uint32_t* mask, FP* u)
+    {
+        uint32_t empty = 0;
+        for (size_t l = 0; l < Lanes; ++l)
+            empty |= mask[l] & (cursor[l] == Block);
+        if (empty)
+            refill();
+
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            u[l] = buffer[cursor[l]][l] * norm;
+            cursor[l] += mask[l];
+        }
+    }
+
+private:
+    // Lanes that used at least half of their numbers move the rest to the front and generate the others,
+    // so most refills generate for many lanes at once
+    void refill()
+    {
+        alignas(64) uint32_t first[Lanes];  // First row to generate
+        uint32_t lowest = Block;
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            first[l] = Block;
+            if (cursor[l] < Block / 2)
+                continue;
+            first[l] = Block - cursor[l];
+            for (uint32_t k = 0; k < first[l]; ++k)
+                buffer[k][l] = buffer[cursor[l] + k][l];
+            cursor[l] = 0;
+            lowest = std::min(lowest, first[l]);
+        }
+
+        for (uint32_t k = lowest; k < Block; ++k)
+        {
+            #pragma omp simd
+            for (size_t l = 0; l < Lanes; ++l)
+            {
+                FP s0 = s[0][l], s1 = s[1][l], s2 = s[2][l], s3 = s[3][l], s4 = s[4][l], s5 = s[5][l];
+
+                // Quotients are below 2^31 in absolute value, so they are truncated through int32 like in U01.
+                // Adding m * (0.5 - copysign(0.5, x)) adds m if x < 0; values are integers, so x - 0.5 < 0 means x <= 0
+                FP p1 = a12 * s1 - a13n * s0;
+                p1 -= FP(int32_t(p1 / m1)) * m1;
+                p1 += m1 * (0.5 - std::copysign(0.5, p1));
+
+                FP p2 = a21 * s5 - a23n * s3;
+                p2 -= FP(int32_t(p2 / m2)) * m2;
+                p2 += m2 * (0.5 - std::copysign(0.5, p2));
+
+                FP d = p1 - p2;
+                FP u = d + m1 * (0.5 - std::copysign(0.5, d - 0.5));
+
+                // Lanes with m = 0 keep their state; x + (y - x) * m is exact for integers
+                FP m = k >= first[l];
+                FP old = buffer[k][l];
+                s[0][l] = s0 + (s1 - s0) * m;
+                s[1][l] = s1 + (s2 - s1) * m;
+                s[2][l] = s2 + (p1 - s2) * m;
+                s[3][l] = s3 + (s4 - s3) * m;
+                s[4][l] = s4 + (s5 - s4) * m;
+                s[5][l] = s5 + (p2 - s5) * m;
+                buffer[k][l] = old + (u - old) * m;
+            }
+        }
+    }
+};
+
+
+// Standard exponential variates of the lane streams, made Block per lane at a time like the uniforms.
+// Exponential clocks sample E / rate with E the next standard variate of the stream whichever clock
+// takes it, so variates can be made before it is known which clocks of a step need them
+template <typename Real, size_t Lanes, size_t Block = 64>
+class Lane_exponentials
+{
+    Lane_streams<Lanes> streams;
+    alignas(64) Real variates[Block + 1][Lanes];  // Row Block is read by lanes that do not draw
+    alignas(64) uint32_t cursor[Lanes];
+
+public:
+    Lane_exponentials()
+    {
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            for (size_t k = 0; k <= Block; ++k)
+                variates[k][l] = 1;
+            cursor[l] = Block;
+        }
+    }
+
+    void load(size_t lane, const RngStream& rng)
+    {
+        streams.load(lane, rng);
+        cursor[lane] = Block;
+    }
+
+    Real next(size_t lane)
+    {
+        if (cursor[lane] == Block)
+            refill();
+        return variates[cursor[lane]++][lane];
+    }
+
+    // Next variate of every lane with mask set; other lanes get their next variate without taking it
+    void next(const uint32_t* mask, Real* e)
+    {
+        uint32_t empty = 0;
+        for (size_t l = 0; l < Lanes; ++l)
+            empty |= mask[l] & (cursor[l] == Block);
+        if (empty)
+            refill();
+
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            e[l] = variates[cursor[l]][l];
+            cursor[l] += mask[l];
+        }
+    }
+
+private:
+    void refill()
+    {
+        alignas(64) uint32_t first[Lanes];
+        uint32_t lowest = Block;
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            first[l] = Block;
+            if (cursor[l] < Block / 2)
+                continue;
+            first[l] = Block - cursor[l];
+            for (uint32_t k = 0; k < first[l]; ++k)
+                variates[k][l] = variates[cursor[l] + k][l];
+            cursor[l] = 0;
+            lowest = std::min(lowest, first[l]);
+        }
+
+        alignas(64) uint32_t mask[Lanes];
+        for (uint32_t k = lowest; k < Block; ++k)
+        {
+            for (size_t l = 0; l < Lanes; ++l)
+                mask[l] = k >= first[l];
+            generate(mask, variates[k]);
+        }
+    }
+
+    // Variates of lanes with mask set into out, like generate_exponential with rate 1
+    void generate(const uint32_t* mask, Real* out)
+    {
+        alignas(64) FP u[Lanes];
+        streams.next(mask, u);
+
+        if (exponential_sampler != Exponential_sampler::ZIGGURAT)
+        {
+            for (size_t l = 0; l < Lanes; ++l)
+                if (mask[l])
+                    out[l] = Real(-std::log(u[l]));
+            return;
+        }
+
+        const Ziggurat_tables<Real>& z = ziggurat_tables<Real>;
+        alignas(64) uint32_t positions[Lanes];
+        alignas(64) uint32_t layers[Lanes];
+        alignas(64) uint32_t fast[Lanes];
+
+        // j = floor(u * 2^32) in two exact halves, conversions to int32 vectorize everywhere
+        #pragma omp simd
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            FP high = u[l] * 65536.0;
+            int32_t high_bits = int32_t(high);
+            uint32_t j = uint32_t(high_bits) << 16 | uint32_t(int32_t((high - high_bits) * 65536.0));
+            layers[l] = j & 255;
+            positions[l] = j >> 8;
+        }
+
+        // Table lookups are gathers; they vectorize where the instruction set has them
+        uint32_t slow = 0;
+        #pragma omp simd reduction(|:slow)
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            fast[l] = (positions[l] != 0) & (positions[l] < z.k[layers[l]]);
+            Real value = Real(int32_t(positions[l])) * z.w[layers[l]];
+            out[l] = blend(mask[l] & fast[l], value, out[l]);
+            slow |= mask[l] & (fast[l] ^ 1);
+        }
+
+        // About 1% of samples miss the rectangle and finish one lane at a time
+        if (slow)
+            for (size_t l = 0; l < Lanes; ++l)
+                if (mask[l] && !fast[l])
+                    out[l] = ziggurat_exponential_slow<Real>(positions[l], layers[l], [this, l]() { return streams.next(l); });
+    }
+};
+
+
+template <typename Real, size_t Lanes>
+class Lockstep_engine
+{
+    using System_type = Basic_system<Real>;
+    using Statistics = typename System_type::Statistics;
+
+    enum : uint32_t { MALE = System_type::MALE, FEMALE = System_type::FEMALE, SERVED = System_type::SERVED };
+
+    static constexpr size_t Cycles = 64;  // Ended cycles a lane keeps before they are moved to its statistics
+
+    // Transition of the system table with the cost rate of the new state, all fields of one lookup
+    struct Step
+    {
+        uint32_t male;
+        uint32_t female;
+        uint32_t served;
+        uint32_t male_joins;    // Male event of the new state is MALE, not MALE_LEFT
+        uint32_t female_joins;
+        FP cost_rate;           // Cost per unit time of the new state
+    };
+
+    const System_type& system;
+    std::vector<Step> steps;  // Indexed like the transition table
+    std::array<FP, 3> rates;
+    FP initial_cost_rate;
+    uint32_t female_stride;
+    uint32_t served_stride;
+
+    // Stopped service clock is INFINITY instead of 0 of State, so the next event is the earliest clock
+    Lane_exponentials<Real, Lanes> variates;
+    alignas(64) Real clocks[3][Lanes];
+    alignas(64) uint32_t male[Lanes];
+    alignas(64) uint32_t female[Lanes];
+    alignas(64) uint32_t served[Lanes];
+    alignas(64) uint32_t male_joins[Lanes];
+    alignas(64) uint32_t female_joins[Lanes];
+    alignas(64) uint32_t queue_was_empty[Lanes];
+    alignas(64) uint32_t active[Lanes];
+    alignas(64) FP cost_rate[Lanes];
+    alignas(64) FP now[Lanes];
+    alignas(64) FP downtime[Lanes];
+    alignas(64) FP cycle_cost[Lanes];
+    alignas(64) uint32_t cycle_male[Lanes];
+    alignas(64) uint32_t cycle_female[Lanes];
+    alignas(64) uint64_t total_male[Lanes];
+    alignas(64) uint64_t total_female[Lanes];
+    alignas(64) uint64_t total_male_left[Lanes];
+    alignas(64) uint64_t total_female_left[Lanes];
+
+    // Ended cycles not yet in statistics
+    alignas(64) FP cycle_costs[Cycles][Lanes];
+    alignas(64) uint32_t cycle_males[Cycles][Lanes];
+    alignas(64) uint32_t cycle_females[Cycles][Lanes];
+    alignas(64) uint32_t cycles[Lanes];
+
+    // Event of the current step, masks and samples
+    alignas(64) uint32_t event[Lanes];
+    alignas(64) uint32_t index[Lanes];  // Of the state after the event in the table
+    alignas(64) Real passed_time[Lanes];
+    alignas(64) uint32_t needs_service[Lanes];
+    alignas(64) uint32_t needs_arrival[Lanes];
+    alignas(64) uint32_t ended_cycle[Lanes];
+    alignas(64) FP arrival_rates[Lanes];
+    alignas(64) FP service_rates[Lanes];
+    alignas(64) Real arrival_samples[Lanes];
+
+    std::array<Statistics, Lanes> stat;
+    std::array<size_t, Lanes> replication;
+
+public:
+    static bool supported(const System_type& system)
+    {
+        for (size_t clock = 0; clock < 3; ++clock)
+            if (!system.distributions[clock].is_memoryless())
+                return false;
+        if (!system.arrival_rates[MALE].empty() || !system.arrival_rates[FEMALE].empty() || system.transitions.empty())
+            return false;
+
+        // Cost must be linear in time to be tabulated as a rate
+        for (size_t male = 0; male <= system.male_queue_limit; ++male)
+            for (size_t female = 0; female <= system.female_queue_limit; ++female)
+                for (size_t served = 0; served <= system.served_limit; ++served)
+                {
+                    FP rate = system.cost_function({male, female, served}, 1);
+                    FP value = system.cost_function({male, female, served}, 3.25);
+                    if (std::abs(value - 3.25 * rate) > 1e-12 * std::abs(value))
+                        return false;
+                }
+        return true;
+    }
+
+    explicit Lockstep_engine(const System_type& system): system(system), steps(system.transitions.size()),
+            rates{system.distributions[MALE].get_rate(), system.distributions[FEMALE].get_rate(), system.distributions[SERVED].get_rate()},
+            initial_cost_rate(system.cost_function({0, 0, 0}, 1)),
+            female_stride(uint32_t(system.female_queue_limit + 1)), served_stride(uint32_t(system.served_limit + 1))
+    {
+        for (size_t i = 0; i < steps.size(); ++i)
+        {
+            const auto& t = system.transitions[i];
+            steps[i] = {t.male, t.female, t.served, t.male_event == MALE, t.female_event == FEMALE,
+                        system.cost_function({t.male, t.female, t.served}, 1)};
+        }
+
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            service_rates[l] = rates[SERVED];
+            active[l] = 0;
+            start_state(l);
+        }
+    }
+
+    // Runs replications next, next + 1, ... until all rngs.size() are taken; several engines may share next
+    void run(std::vector<RngStream>& rngs, std::vector<Statistics>& results, std::atomic<size_t>& next)
+    {
+        size_t running = 0;
+        for (size_t l = 0; l < Lanes; ++l)
+            running += start(l, rngs, results, next);
+
+        while (running > 0)
+        {
+            step();
+
+            // Lanes are visited one by one only when a cycle buffer is full or a run has ended
+            uint32_t visit = 0;
+            for (size_t l = 0; l < Lanes; ++l)
+                visit |= (cycles[l] == Cycles) | (active[l] & (now[l] >= system.T));
+            if (!visit)
+                continue;
+
+            for (size_t l = 0; l < Lanes; ++l)
+            {
+                if (cycles[l] == Cycles)
+                    move_cycles(l);
+                if (active[l] && now[l] >= system.T)
+                {
+                    finish(l, results);
+                    running -= 1 - start(l, rngs, results, next);
+                }
+            }
+        }
+    }
+
+private:
+    void start_state(size_t l)
+    {
+        male[l] = female[l] = served[l] = 0;
+        male_joins[l] = system.male_queue_limit > 0;
+        female_joins[l] = system.female_queue_limit > 0;
+        queue_was_empty[l] = 1;
+        cost_rate[l] = initial_cost_rate;
+        now[l] = 0;
+        downtime[l] = 0;
+        cycle_cost[l] = 0;
+        cycle_male[l] = cycle_female[l] = 0;
+        cycles[l] = 0;
+        total_male[l] = total_female[l] = total_male_left[l] = total_female_left[l] = 0;
+        clocks[MALE][l] = clocks[FEMALE][l] = 1;
+        clocks[SERVED][l] = INFINITY;
+    }
+
+    // Takes the next replication into the lane like System::start; returns false if none is left
+    bool start(size_t l, std::vector<RngStream>& rngs, std::vector<Statistics>& results, std::atomic<size_t>& next)
+    {
+        for (;;)
+        {
+            size_t r = next.fetch_add(1);
+            if (r >= rngs.size())
+            {
+                active[l] = 0;
+                return false;
+            }
+
+            variates.load(l, rngs[r]);
+            replication[l] = r;
+            stat[l] = Statistics();
+            start_state(l);
+            clocks[MALE][l] = variates.next(l) / Real(rates[MALE]);
+            clocks[FEMALE][l] = variates.next(l) / Real(rates[FEMALE]);
+            active[l] = 1;
+
+            if (system.T > 0)
+                return true;
+            finish(l, results);  // Run without events
+        }
+    }
+
+    void move_cycles(size_t l)
+    {
+        for (size_t c = 0; c < cycles[l]; ++c)
+        {
+            stat[l].cycle_cost_value.push_back(cycle_costs[c][l]);
+            stat[l].cycle_male_arrivals.push_back(cycle_males[c][l]);
+            stat[l].cycle_female_arrivals.push_back(cycle_females[c][l]);
+        }
+        cycles[l] = 0;
+    }
+
+    void finish(size_t l, std::vector<Statistics>& results)
+    {
+        move_cycles(l);
+        stat[l].downtime = downtime[l];
+        stat[l].total_male = total_male[l];
+        stat[l].total_female = total_female[l];
+        stat[l].total_male_left = total_male_left[l];
+        stat[l].total_female_left = total_female_left[l];
+        results[replication[l]] = std::move(stat[l]);
+    }
+
+    // Exponential times with rate[l] into out[l] for lanes with mask set
+    void sample(const uint32_t* mask, const FP* rate, Real* out)
+    {
+        alignas(64) Real e[Lanes];
+        variates.next(mask, e);
+
+        #pragma omp simd
+        for (size_t l = 0; l < Lanes; ++l)
+            out[l] = blend(mask[l], e[l] / Real(rate[l]), out[l]);
+    }
+
+    // One event in every lane: the same operations as State::move_to_next_state and the estimator part of simulate.
+    // Conditional updates are blends or multiplications by 0 and 1, so the loops have no branches
+    void step()
+    {
+        #pragma omp simd
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            // Ties go to the later clock like in State::move_to_next_state
+            Real c0 = clocks[MALE][l], c1 = clocks[FEMALE][l], c2 = clocks[SERVED][l];
+            uint32_t male_event = uint32_t(c0 < c1) & uint32_t(c0 < c2);
+            uint32_t female_event = (male_event ^ 1) & uint32_t(c1 < c2);
+            uint32_t served_event = (male_event | female_event) ^ 1;
+            Real dt = std::min(std::min(c0, c1), c2) * Real(active[l]);  // Idle lanes stand still
+
+            cycle_cost[l] += cost_rate[l] * FP(dt);
+            downtime[l] += FP(dt) * queue_was_empty[l];
+            now[l] += dt;
+
+            uint32_t male_joined = male_event & male_joins[l];
+            uint32_t female_joined = female_event & female_joins[l];
+            cycle_male[l] += male_joined;
+            cycle_female[l] += female_joined;
+            total_male[l] += male_joined;
+            total_female[l] += female_joined;
+            total_male_left[l] += male_event ^ male_joined;
+            total_female_left[l] += female_event ^ female_joined;
+
+            // Idle lanes look up entry 0, their states may be anything
+            index[l] = (((male[l] + male_joined) * female_stride + female[l] + female_joined) * served_stride + served[l] - served_event) * active[l];
+            event[l] = male_event * MALE + female_event * FEMALE + served_event * SERVED;
+            passed_time[l] = dt;
+        }
+
+        // Conduction, a gather from the table
+        const Step* table = steps.data();
+        #pragma omp simd
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            const Step& t = table[index[l]];
+            male[l] = t.male;
+            female[l] = t.female;
+            served[l] = t.served;
+            male_joins[l] = t.male_joins;
+            female_joins[l] = t.female_joins;
+            cost_rate[l] = t.cost_rate;
+        }
+
+        // Clocks that do not fire run down; service clock restarts or stops
+        #pragma omp simd
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            Real c0 = clocks[MALE][l], c1 = clocks[FEMALE][l], c2 = clocks[SERVED][l];
+            Real dt = passed_time[l];
+            uint32_t male_event = event[l] == MALE, female_event = event[l] == FEMALE, served_event = event[l] == SERVED;
+            uint32_t serving = c2 != Real(INFINITY);
+
+            clocks[MALE][l] = c0 - dt * Real(served_event | female_event);
+            clocks[FEMALE][l] = c1 - dt * Real(served_event | male_event);
+            clocks[SERVED][l] = blend(served_event & (served[l] == 0), Real(INFINITY), c2 - dt * Real(served_event ^ 1));
+
+            needs_service[l] = ((serving ^ 1) | served_event) & (served[l] != 0) & active[l];
+            needs_arrival[l] = (male_event | female_event) & active[l];
+            ended_cycle[l] = ((male[l] | female[l] | served[l]) == 0) & active[l];
+            queue_was_empty[l] = (male[l] | female[l]) == 0;
+        }
+
+        // Ended cycles go to the buffer of the lane and the cycle counters restart
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            uint32_t c = cycles[l], ended = ended_cycle[l];
+            cycle_costs[c][l] = cycle_cost[l];
+            cycle_males[c][l] = cycle_male[l];
+            cycle_females[c][l] = cycle_female[l];
+            cycles[l] = c + ended;
+            cycle_cost[l] *= FP(ended ^ 1);
+            cycle_male[l] *= ended ^ 1;
+            cycle_female[l] *= ended ^ 1;
+            arrival_rates[l] = rates[event[l]];
+        }
+
+        sample(needs_service, service_rates, clocks[SERVED]);
+        sample(needs_arrival, arrival_rates, arrival_samples);
+
+        #pragma omp simd
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            clocks[MALE][l] = blend(needs_arrival[l] & (event[l] == MALE), arrival_samples[l], clocks[MALE][l]);
+            clocks[FEMALE][l] = blend(needs_arrival[l] & (event[l] == FEMALE), arrival_samples[l], clocks[FEMALE][l]);
+        }
+    }
+};
+
+
+// Runs n replications of system in lanes of lock-step engines, one engine per thread.
+// Replication i uses the i-th of n new streams; systems the engine does not support run the scalar loop
+template <size_t Lanes = 8, typename Real>
+std::vector<typename Basic_system<Real>::Statistics> run_lockstep(const Basic_system<Real>& system, size_t n)
+{
+    std::vector<RngStream> streams(n);
+    std::vector<typename Basic_system<Real>::Statistics> stat_vector(n);
+
+    if (!Lockstep_engine<Real, Lanes>::supported(system))
+    {
+        Basic_system<Real> scalar = system;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < n; ++i)
+            stat_vector[i] = scalar.template run<COLLECT_ESTIMATOR>(streams[i]);
+        return stat_vector;
+    }
+
+    std::atomic<size_t> next{0};
+
+    #pragma omp parallel
+    {
+        Lockstep_engine<Real, Lanes> engine(system);
+        engine.run(streams, stat_vector, next);
+    }
+    return stat_vector;
+}
+
+#endif // __LOCKSTEP_H__
@@ -0,0 +1,207 @@
+#ifndef __MULTIPROCESS_H__
+#define __MULTIPROCESS_H__
+
+// Runner of independent replications in separate worker processes (POSIX only).
+// Every worker simulates a disjoint range of streams and writes a summary of each replication
+// into shared memory; the parent merges summaries of all replications that were completed.
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <new>
+#include <algorithm>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "system.h"
+
+
+using FP = double;
+
+
+// Summary of one replication in shared memory. Only trivially copyable data is stored here
+struct Replication_summary
+{
+    std::atomic<uint32_t> done;  // Set by worker after all other fields are written
+    FP downtime;
+    uint64_t total_male;
+    uint64_t total_female;
+    uint64_t total_male_left;
+    uint64_t total_female_left;
+    Regenerative_accumulator cycles;  // (cycle cost, clients per cycle) pairs
+};
+
+
+struct Multiprocess_result
+{
+    size_t completed = 0;
+    FP downtime = 0;
+    size_t total_male = 0;
+    size_t total_female = 0;
+    size_t total_male_left = 0;
+    size_t total_female_left = 0;
+    Regenerative_accumulator cycles;
+
+    std::vector<size_t> failed_workers;
+    std::vector<size_t> lost_replications;
+
+    void print() const
+    {
+        std::cout << "\n===== MULTIPROCESS RESULT =====\n";
+        std::cout << "Completed replications:\t" << completed << '\n';
+        std::cout << "Lost replications:\t" << lost_replications.size() << '\n';
+        std::cout << "Failed workers:\t\t" << failed_workers.size() << '\n';
+        std::cout << "Total downtime:\t\t" << downtime << '\n';
+        std::cout << "Total male:\t\t" << total_male << '\n';
+        std::cout << "Total female:\t\t" << total_female << '\n';
+        std::cout << "Male left:\t\t" << total_male_left << '\n';
+        std::cout << "Female left:\t\t" << total_female_left << '\n';
+        std::cout << "Cycles:\t\t\t" << cycles.n << '\n';
+        std::cout << "===============================\n";
+    }
+};
+
+
+// CPU lists of NUMA nodes from sysfs; empty if they are not available
+std::vector<std::vector<int>> numa_node_cpus()
+{
+    std::vector<std::vector<int>> nodes;
+    for (size_t node = 0;; ++node)
+    {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!in)
+            break;
+
+        // Format: "0-3,8-11"
+        std::vector<int> cpus;
+        std::string range;
+        while (std::getline(in, range, ','))
+        {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        nodes.push_back(cpus);
+    }
+    return nodes;
+}
+
+void pin_to_cpus(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        std::cerr << "WARNING: failed to pin worker " << getpid() << " to NUMA node.\n";
+#endif
+}
+
+
+// Runs n replications of system in `workers` processes. Replication i always uses the i-th stream,
+// so the result does not depend on the number of workers. With pin_workers, worker w is bound to
+// CPUs of NUMA node w % (number of nodes). If a worker crashes, replications it has finished are kept
+// and the rest of its range is reported in lost_replications. With a progress board, worker w publishes
+// into slot w, so the board needs a slot per worker.
+// Must be called before any OpenMP parallel region of the parent, because OpenMP runtime does not survive fork.
+Multiprocess_result run_multiprocess(System& system, size_t n, size_t workers, bool pin_workers = false)
+{
+    Multiprocess_result result;
+    if (n == 0)
+        return result;
+    workers = std::max(size_t(1), std::min(workers, n));
+
+    size_t bytes = n * sizeof(Replication_summary);
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        std::cerr << "ERROR: failed to map shared memory for " << n << " replications.\n";
+        return result;
+    }
+    Replication_summary* summaries = static_cast<Replication_summary*>(memory);
+    for (size_t i = 0; i < n; ++i)
+        new (&summaries[i]) Replication_summary{};
+
+    std::vector<RngStream> streams(n);
+    auto nodes = pin_workers ? numa_node_cpus() : std::vector<std::vector<int>>();
+
+    std::vector<pid_t> pids(workers, -1);
+    for (size_t w = 0; w < workers; ++w)
+    {
+        size_t begin = n * w / workers;
+        size_t end = n * (w + 1) / workers;
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            std::cerr << "ERROR: failed to start worker " << w << ".\n";
+            continue;
+        }
+        if (pid == 0)
+        {
+            if (!nodes.empty())
+                pin_to_cpus(nodes[w % nodes.size()]);
+            system.set_progress_first_slot(w);
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                System::Statistics stat = system.run<COLLECT_ESTIMATOR>(streams[i]);
+
+                Replication_summary& summary = summaries[i];
+                summary.downtime = stat.downtime;
+                summary.total_male = stat.total_male;
+                summary.total_female = stat.total_female;
+                summary.total_male_left = stat.total_male_left;
+                summary.total_female_left = stat.total_female_left;
+                for (size_t c = 0; c < stat.cycle_cost_value.size(); ++c)
+                    summary.cycles.add(stat.cycle_cost_value[c], FP(stat.cycle_male_arrivals[c] + stat.cycle_female_arrivals[c]));
+
+                summary.done.store(1, std::memory_order_release);
+            }
+            _exit(0);
+        }
+        pids[w] = pid;
+    }
+
+    for (size_t w = 0; w < workers; ++w)
+    {
+        int status = 0;
+        if (pids[w] < 0 || waitpid(pids[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            result.failed_workers.push_back(w);
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Replication_summary& summary = summaries[i];
+        if (!summary.done.load(std::memory_order_acquire))
+        {
+            result.lost_replications.push_back(i);
+            continue;
+        }
+
+        ++result.completed;
+        result.downtime += summary.downtime;
+        result.total_male += summary.total_male;
+        result.total_female += summary.total_female;
+        result.total_male_left += summary.total_male_left;
+        result.total_female_left += summary.total_female_left;
+        result.cycles.merge(summary.cycles);
+    }
+
+    munmap(memory, bytes);
+    return result;
+}
+
+#endif // defined(__unix__) || defined(__APPLE__)
+
+#endif // __MULTIPROCESS_H__
@@ -0,0 +1,371 @@
+#ifndef __MULTISERVER_H__
+#define __MULTISERVER_H__
+
+// Model with K servers working in parallel. Server s takes a batch of at most capacity[s] customers
+// of one sex and serves it for a time of its own service clock. Every clock (two arrival clocks and
+// one per server) keeps the absolute time of its next event in an indexed binary heap, so selecting
+// the next event and restarting a clock cost O(log K) instead of a scan over all clocks
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include "system.h"
+
+
+using FP = double;
+
+
+// Min-heap of clocks 0..n-1 by time of their next event. Stopped clocks are not in the heap.
+// Equal times are ordered by clock index, so runs do not depend on the order of updates
+class Event_heap
+{
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    std::vector<FP> times;
+    std::vector<uint32_t> heap;
+    std::vector<uint32_t> position;  // Index of clock in heap or npos
+
+public:
+    explicit Event_heap(size_t clocks = 0): times(clocks, INFINITY), position(clocks, npos) {}
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    size_t top() const
+    {
+        return heap[0];
+    }
+
+    FP top_time() const
+    {
+        return times[heap[0]];
+    }
+
+    bool running(size_t clock) const
+    {
+        return position[clock] != npos;
+    }
+
+    FP time(size_t clock) const
+    {
+        return times[clock];
+    }
+
+    // Starts the clock or moves its event to the new time
+    void set(size_t clock, FP time)
+    {
+        times[clock] = time;
+        if (position[clock] == npos)
+        {
+            position[clock] = heap.size();
+            heap.push_back(uint32_t(clock));
+            sift_up(position[clock]);
+        }
+        else
+        {
+            sift_up(position[clock]);
+            sift_down(position[clock]);
+        }
+    }
+
+    void stop(size_t clock)
+    {
+        uint32_t i = position[clock];
+        if (i == npos)
+            return;
+
+        uint32_t last = heap.back();
+        heap.pop_back();
+        position[clock] = npos;
+        times[clock] = INFINITY;
+        if (i < heap.size())
+        {
+            heap[i] = last;
+            position[last] = i;
+            sift_up(i);
+            sift_down(position[last]);
+        }
+    }
+
+private:
+    bool before(uint32_t a, uint32_t b) const
+    {
+        return times[a] < times[b] || (times[a] == times[b] && a < b);
+    }
+
+    void place(size_t i, uint32_t clock)
+    {
+        heap[i] = clock;
+        position[clock] = uint32_t(i);
+    }
+
+    void sift_up(size_t i)
+    {
+        uint32_t clock = heap[i];
+        while (i > 0 && before(clock, heap[(i - 1) / 2]))
+        {
+            place(i, heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, clock);
+    }
+
+    void sift_down(size_t i)
+    {
+        uint32_t clock = heap[i];
+        size_t n = heap.size();
+        for (;;)
+        {
+            size_t child = 2 * i + 1;
+            if (child >= n)
+                break;
+            if (child + 1 < n && before(heap[child + 1], heap[child]))
+                ++child;
+            if (!before(heap[child], clock))
+                break;
+            place(i, heap[child]);
+            i = child;
+        }
+        place(i, clock);
+    }
+};
+
+
+// Number of male and female customers a free server of given capacity takes from the queues
+using Batch_loader = std::function<std::array<size_t, 2>(size_t male, size_t female, size_t capacity)>;
+
+// Like default_conductor: the longer queue (male on ties) loads as many customers as fit
+Batch_loader default_batch_loader = [](size_t male, size_t female, size_t capacity) -> std::array<size_t, 2>
+{
+    if (male >= female)
+        return {std::min(male, capacity), 0};
+    return {0, std::min(female, capacity)};
+};
+
+
+class Multi_server_system
+{
+public:
+    enum Clock
+    {
+        MALE,
+        FEMALE,
+        FIRST_SERVER  // Clock of server s is FIRST_SERVER + s
+    };
+
+    struct Statistics
+    {
+        FP downtime = 0;  // Time with both queues empty
+        size_t total_male = 0;
+        size_t total_female = 0;
+        size_t total_male_left = 0;
+        size_t total_female_left = 0;
+        size_t batches = 0;
+        size_t served = 0;
+        std::vector<FP> busy_time;  // Per server
+
+        std::vector<FP> cycle_durations;
+        std::vector<FP> cycle_cost_value;
+        std::vector<size_t> cycle_male_arrivals;
+        std::vector<size_t> cycle_female_arrivals;
+
+        void print() const
+        {
+            Regenerative_accumulator cycles;
+            for (size_t c = 0; c < cycle_cost_value.size(); ++c)
+                cycles.add(cycle_cost_value[c], FP(cycle_male_arrivals[c] + cycle_female_arrivals[c]));
+
+            std::cout << "\n===== MULTI-SERVER STATISTICS =====\n";
+            std::cout << "Total downtime:\t\t" << downtime << '\n';
+            std::cout << "Total male:\t\t" << total_male << '\n';
+            std::cout << "Total female:\t\t" << total_female << '\n';
+            std::cout << "Male left:\t\t" << total_male_left << '\n';
+            std::cout << "Female left:\t\t" << total_female_left << '\n';
+            std::cout << "Batches:\t\t" << batches << " (mean size " << (batches ? FP(served) / batches : 0) << ")\n";
+            std::cout << "Cycles:\t\t\t" << cycles.n << '\n';
+            if (cycles.n > 1)
+            {
+                auto [lower, upper] = cycles.confidence_interval();
+                std::cout << "Cost per customer:\t" << cycles.value() << "\t[" << lower << ", " << upper << "]\n";
+            }
+            std::cout << "===================================\n";
+        }
+    };
+
+private:
+    FP T;
+    FP l1, l2, mu;
+    size_t male_queue_limit = UINT32_MAX;
+    size_t female_queue_limit = UINT32_MAX;
+    std::vector<size_t> capacities;
+    std::array<Distribution, 2> arrivals;
+    std::vector<Distribution> services;  // Per server
+    Batch_loader loader;
+    std::function<FP(std::array<size_t, 3>, FP)> cost_function;
+
+public:
+    // capacities[s] is the batch capacity of server s; all servers serve with rate mu
+    Multi_server_system(FP time, FP l1, FP l2, FP mu, std::vector<size_t> capacities, Batch_loader loader = default_batch_loader,
+                        std::function<FP(std::array<size_t, 3>, FP)> cost_function = default_cost_function):
+            T(time), l1(l1), l2(l2), mu(mu), capacities(std::move(capacities)),
+            arrivals{Distribution::exponential(l1), Distribution::exponential(l2)},
+            services(this->capacities.size(), Distribution::exponential(mu)), loader(loader), cost_function(cost_function) {}
+
+    void set_time(FP time)
+    {
+        T = time;
+    }
+
+    void set_queues_limits(size_t male_queue_limit, size_t female_queue_limit)
+    {
+        this->male_queue_limit = male_queue_limit;
+        this->female_queue_limit = female_queue_limit;
+    }
+
+    void set_arrival_distribution(Clock clock, const Distribution& distribution)
+    {
+        if (clock == MALE || clock == FEMALE)
+            arrivals[clock] = distribution;
+        else
+            std::cerr << "ERROR: set_arrival_distribution expects MALE or FEMALE clock.\n";
+    }
+
+    void set_service_distribution(size_t server, const Distribution& distribution)
+    {
+        if (server < services.size())
+            services[server] = distribution;
+        else
+            std::cerr << "ERROR: no server " << server << ", there are " << services.size() << ".\n";
+    }
+
+    size_t get_servers() const
+    {
+        return capacities.size();
+    }
+
+    // Cost function receives state (male queue, female queue, busy servers)
+    Statistics run(RngStream rng = RngStream()) const
+    {
+        const size_t k = capacities.size();
+        Statistics stat;
+        stat.busy_time.assign(k, 0);
+
+        Event_heap events(FIRST_SERVER + k);
+        std::vector<size_t> batch(k, 0);
+        std::vector<size_t> free_servers(k);  // Stack; server 0 is taken first
+        for (size_t s = 0; s < k; ++s)
+            free_servers[s] = k - 1 - s;
+
+        size_t male = 0, female = 0;
+        FP now = 0;
+        FP cycle_start_time = 0, cycle_cost = 0;
+        size_t cycle_male = 0, cycle_female = 0;
+        bool regenerative = arrivals[MALE].is_memoryless() && arrivals[FEMALE].is_memoryless();
+
+        events.set(MALE, arrivals[MALE].sample(rng));
+        events.set(FEMALE, arrivals[FEMALE].sample(rng));
+
+        while (events.top_time() < T)
+        {
+            size_t clock = events.top();
+            FP time = events.top_time();
+            FP passed_time = time - now;
+
+            cycle_cost += cost_function({male, female, k - free_servers.size()}, passed_time);
+            if (male == 0 && female == 0)
+                stat.downtime += passed_time;
+            now = time;
+
+            if (clock == MALE)
+            {
+                if (male < male_queue_limit) { ++male; ++cycle_male; ++stat.total_male; }
+                else ++stat.total_male_left;
+                events.set(MALE, now + arrivals[MALE].sample(rng));
+            }
+            else if (clock == FEMALE)
+            {
+                if (female < female_queue_limit) { ++female; ++cycle_female; ++stat.total_female; }
+                else ++stat.total_female_left;
+                events.set(FEMALE, now + arrivals[FEMALE].sample(rng));
+            }
+            else
+            {
+                size_t s = clock - FIRST_SERVER;
+                stat.served += batch[s];
+                batch[s] = 0;
+                events.stop(clock);
+                free_servers.push_back(s);
+            }
+
+            // Free servers take batches while someone is waiting
+            while (!free_servers.empty() && (male > 0 || female > 0))
+            {
+                size_t s = free_servers.back();
+                // Loader may ask for more than is queued or fits; the batch holds only customers that exist
+                auto [male_taken, female_taken] = loader(male, female, capacities[s]);
+                male_taken = std::min({male_taken, male, capacities[s]});
+                female_taken = std::min({female_taken, female, capacities[s] - male_taken});
+                if (male_taken + female_taken == 0)
+                    break;
+                male -= male_taken;
+                female -= female_taken;
+                batch[s] = male_taken + female_taken;
+                free_servers.pop_back();
+
+                FP service_time = services[s].sample(rng);
+                stat.busy_time[s] += std::min(service_time, T - now);
+                events.set(FIRST_SERVER + s, now + service_time);
+                ++stat.batches;
+            }
+
+            // Empty system with memoryless arrival clocks is a regeneration point
+            if (regenerative && male == 0 && female == 0 && free_servers.size() == k)
+            {
+                stat.cycle_durations.push_back(now - cycle_start_time);
+                stat.cycle_cost_value.push_back(cycle_cost);
+                stat.cycle_male_arrivals.push_back(cycle_male);
+                stat.cycle_female_arrivals.push_back(cycle_female);
+                cycle_start_time = now;
+                cycle_cost = 0;
+                cycle_male = cycle_female = 0;
+            }
+        }
+
+        return stat;
+    }
+
+    // Runs n replications using multi-threading
+    std::vector<Statistics> run(size_t n) const
+    {
+        std::vector<RngStream> streams(n);
+        std::vector<Statistics> stat_vector(n);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < n; ++i)
+            stat_vector[i] = run(streams[i]);
+
+        return stat_vector;
+    }
+
+    void print() const
+    {
+        std::cout << "\n==== MULTI-SERVER SYSTEM SUMMARY ====\n";
+        std::cout << "Total time of work:\t" << T << '\n';
+        std::cout << "Parament for male:\t" << l1 << '\n';
+        std::cout << "Parament for female:\t" << l2 << '\n';
+        std::cout << "Parament for serving:\t" << mu << '\n';
+        std::cout << "Servers:\t\t" << capacities.size() << '\n';
+        std::cout << "Male queue limit:\t" << male_queue_limit << '\n';
+        std::cout << "Female queue limit:\t" << female_queue_limit << '\n';
+        std::cout << "=====================================\n";
+    }
+};
+
+#endif // __MULTISERVER_H__
@@ -0,0 +1,177 @@
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+// Stochastic approximation search for queue limits and service rate.
+// Service rate is updated by Kiefer-Wolfowitz (two-sided SPSA for one continuous parameter),
+// queue limits by moving to the best neighbor (+-1 of one limit) if it improves the objective.
+// All designs of one iteration are simulated with the same streams (common random numbers),
+// so differences between them are not hidden by simulation noise
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include "system.h"
+
+
+using FP = double;
+
+
+struct Design
+{
+    size_t male_limit;
+    size_t female_limit;
+    FP mu;
+};
+
+
+// Replications of the optimizer collect only totals, downtime and cycles, so objectives can use nothing else
+constexpr unsigned optimizer_collected = COLLECT_CYCLES | COLLECT_CYCLE_DETAILS;
+
+// Objective to minimize, computed for one replication
+using Objective = std::function<FP(const System::Statistics&, const Design&)>;
+
+// Waiting cost per unit time + rejection_penalty per rejected customer per unit time + service_cost * mu.
+// Costs and rejections are both taken over completed cycles and divided by their time, so the incomplete
+// last cycle does not shift the objective. A replication without completed cycles has no value (NaN)
+Objective make_cost_objective(FP rejection_penalty, FP service_cost)
+{
+    return [rejection_penalty, service_cost](const System::Statistics& stat, const Design& design)
+    {
+        FP time = std::accumulate(stat.cycle_durations.begin(), stat.cycle_durations.end(), FP(0));
+        if (!(time > 0))
+            return FP(NAN);
+        FP cost = std::accumulate(stat.cycle_cost_value.begin(), stat.cycle_cost_value.end(), FP(0));
+        FP rejected = FP(std::accumulate(stat.cycle_male_left.begin(), stat.cycle_male_left.end(), size_t(0)) +
+                         std::accumulate(stat.cycle_female_left.begin(), stat.cycle_female_left.end(), size_t(0)));
+        return (cost + rejection_penalty * rejected) / time + service_cost * design.mu;
+    };
+}
+
+
+struct Optimizer_settings
+{
+    size_t iterations = 30;
+    size_t replications = 8;  // Per design and iteration
+
+    // Gains a_k = a / (k + 1 + A)^alpha and c_k = c / (k + 1)^gamma
+    FP a = 1;
+    FP A = 5;
+    FP alpha = 0.602;
+    FP c = 0.2;
+    FP gamma = 0.101;
+
+    FP mu_min = 1e-3;
+    FP mu_max = 1e3;
+    size_t limit_min = 0;
+    size_t limit_max = 1000;
+};
+
+
+struct Optimization_result
+{
+    Design best;
+    FP best_objective;
+    std::vector<Design> path;      // Design at the start of every iteration
+    std::vector<FP> objectives;    // Its objective in that iteration
+
+    void print() const
+    {
+        std::cout << "\n======= OPTIMIZATION =======\n";
+        std::cout << "Iter\tMale\tFemale\tMu\tObjective\n";
+        for (size_t k = 0; k < path.size(); ++k)
+            std::cout << k << '\t' << path[k].male_limit << '\t' << path[k].female_limit << '\t' << path[k].mu << '\t' << objectives[k] << '\n';
+        std::cout << "Best: male limit " << best.male_limit << ", female limit " << best.female_limit
+                  << ", mu " << best.mu << ", objective " << best_objective << '\n';
+        std::cout << "============================\n";
+    }
+};
+
+
+// system gives time, arrival rates, conductor and cost function; its limits and mu are the starting design
+Optimization_result optimize(const System& system, const Objective& objective, const Optimizer_settings& settings = Optimizer_settings())
+{
+    auto [male_limit, female_limit] = system.get_queues_limits();
+    Design current{std::clamp(male_limit, settings.limit_min, settings.limit_max),
+                   std::clamp(female_limit, settings.limit_min, settings.limit_max),
+                   system.get_distribution_params()[2]};
+
+    Optimization_result result{current, INFINITY, {}, {}};
+    std::vector<RngStream> streams(settings.replications);
+
+    for (size_t k = 0; k < settings.iterations; ++k)
+    {
+        FP a_k = settings.a / std::pow(k + 1 + settings.A, settings.alpha);
+        FP c_k = settings.c / std::pow(k + 1, settings.gamma);
+
+        // 0 - current, 1, 2 - mu -+ c_k, 3..6 - neighbors by limits
+        std::vector<Design> designs{current,
+            {current.male_limit, current.female_limit, std::max(settings.mu_min, current.mu - c_k)},
+            {current.male_limit, current.female_limit, std::min(settings.mu_max, current.mu + c_k)}};
+        if (current.male_limit > settings.limit_min) designs.push_back({current.male_limit - 1, current.female_limit, current.mu});
+        if (current.male_limit < settings.limit_max) designs.push_back({current.male_limit + 1, current.female_limit, current.mu});
+        if (current.female_limit > settings.limit_min) designs.push_back({current.male_limit, current.female_limit - 1, current.mu});
+        if (current.female_limit < settings.limit_max) designs.push_back({current.male_limit, current.female_limit + 1, current.mu});
+
+        std::vector<System> systems(designs.size(), system);
+        for (size_t d = 0; d < designs.size(); ++d)
+        {
+            systems[d].set_queues_limits(designs[d].male_limit, designs[d].female_limit);
+            systems[d].set_distribution(System::SERVED, Distribution::exponential(designs[d].mu));
+        }
+
+        std::vector<FP> values(designs.size() * settings.replications);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            size_t d = i / settings.replications;
+            size_t r = i % settings.replications;
+            values[i] = objective(systems[d].run<optimizer_collected>(streams[r]), designs[d]);  // Copy of the same stream for every design
+        }
+
+        // Replications without a value are skipped; a design without any is never chosen
+        std::vector<FP> f(designs.size(), 0);
+        std::vector<size_t> counted(designs.size(), 0);
+        for (size_t i = 0; i < values.size(); ++i)
+            if (std::isfinite(values[i]))
+            {
+                f[i / settings.replications] += values[i];
+                ++counted[i / settings.replications];
+            }
+        for (size_t d = 0; d < designs.size(); ++d)
+            f[d] = counted[d] > 0 ? f[d] / counted[d] : INFINITY;
+
+        result.path.push_back(current);
+        result.objectives.push_back(f[0]);
+        if (f[0] < result.best_objective)
+        {
+            result.best = current;
+            result.best_objective = f[0];
+        }
+
+        // Continuous step
+        FP gradient = (f[2] - f[1]) / (designs[2].mu - designs[1].mu);
+        FP mu = std::isfinite(gradient) ? std::clamp(current.mu - a_k * gradient, settings.mu_min, settings.mu_max) : current.mu;
+
+        // Discrete step
+        size_t best_neighbor = std::min_element(f.begin() + 3, f.end()) - f.begin();
+        if (best_neighbor < f.size() && f[best_neighbor] < f[0])
+        {
+            current.male_limit = designs[best_neighbor].male_limit;
+            current.female_limit = designs[best_neighbor].female_limit;
+        }
+        current.mu = mu;
+
+        // New streams for the next iteration, so the search does not fit one sample path
+        for (RngStream& stream : streams)
+            stream.ResetNextSubstream();
+    }
+
+    return result;
+}
+
+#endif // __OPTIMIZER_H__
@@ -0,0 +1,230 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <omp.h>
+#include "statistics.h"
+
+
+using FP = double;
+
+
+// Data of one completed regeneration cycle
+struct Cycle_record
+{
+    FP cost;
+    FP clients;
+    FP duration;
+};
+
+
+// Lock-free ring buffer for one producer thread and one consumer thread.
+// Capacity is rounded up to a power of two (at least 1), so positions wrap with a mask
+template <typename T>
+class Spsc_queue
+{
+    std::vector<T> buffer;
+    size_t mask;
+
+    static size_t round_up_to_power_of_two(size_t capacity)
+    {
+        size_t power = 1;
+        while (power < capacity)
+            power <<= 1;
+        return power;
+    }
+
+    // head is written only by consumer and tail only by producer, so they live in different cache lines
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+public:
+    Spsc_queue(size_t capacity = 4096): buffer(round_up_to_power_of_two(capacity)), mask(buffer.size() - 1) {}
+
+    bool push(const T& value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == buffer.size())
+            return false;  // Full
+
+        buffer[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;  // Empty
+
+        value = buffer[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+
+// Estimator thread that drains cycle records of simulation threads and keeps running confidence interval.
+// It asks simulation threads to stop when relative half-width of the interval drops below target_relative_error
+class Live_estimator
+{
+public:
+    struct Estimate
+    {
+        size_t cycles;
+        FP value;
+        FP lower;
+        FP upper;
+    };
+
+    // Producer side of one queue; used by exactly one simulation thread at a time
+    class Channel
+    {
+        Spsc_queue<Cycle_record> queue;
+        const std::atomic<bool>& stop;
+
+    public:
+        Channel(const std::atomic<bool>& stop): stop(stop) {}
+
+        void push(const Cycle_record& record)
+        {
+            while (!queue.push(record))
+                std::this_thread::yield();
+        }
+
+        bool stop_requested() const
+        {
+            return stop.load(std::memory_order_relaxed);
+        }
+
+        friend class Live_estimator;
+    };
+
+private:
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> producers_done{false};
+    std::thread consumer;
+
+    FP confidence_level;
+    FP target_relative_error;
+    size_t min_cycles;
+    std::chrono::milliseconds report_period;
+    std::function<void(const Estimate&)> on_report;
+
+    Regenerative_accumulator accumulator;
+
+public:
+    // target_relative_error = 0 disables early termination; on_report is called every report_period from estimator thread
+    Live_estimator(FP confidence_level = 0.95, FP target_relative_error = 0, size_t min_cycles = 1000,
+                   std::chrono::milliseconds report_period = std::chrono::milliseconds(1000),
+                   std::function<void(const Estimate&)> on_report = nullptr, size_t producers = omp_get_max_threads()):
+        confidence_level(confidence_level), target_relative_error(target_relative_error), min_cycles(min_cycles),
+        report_period(report_period), on_report(on_report)
+    {
+        for (size_t i = 0; i < producers; ++i)
+            channels.push_back(std::make_unique<Channel>(stop));
+    }
+
+    ~Live_estimator()
+    {
+        if (consumer.joinable())
+            finish();
+    }
+
+    Channel& channel(size_t producer)
+    {
+        return *channels[producer];
+    }
+
+    size_t num_channels() const
+    {
+        return channels.size();
+    }
+
+    // Every start begins a new estimate, so an estimator can serve several runs one after another
+    void start()
+    {
+        stop = false;
+        producers_done = false;
+        accumulator = Regenerative_accumulator();
+        consumer = std::thread([this]() { consume(); });
+    }
+
+    // Called after all producers have finished; drains the rest of the records
+    void finish()
+    {
+        producers_done.store(true, std::memory_order_release);
+        consumer.join();
+    }
+
+    bool stopped_early() const
+    {
+        return stop.load(std::memory_order_relaxed);
+    }
+
+    // Valid after finish()
+    Estimate get_estimate() const
+    {
+        auto [lower, upper] = accumulator.confidence_interval(confidence_level);
+        return {accumulator.n, accumulator.value(), lower, upper};
+    }
+
+    const Regenerative_accumulator& get_accumulator() const
+    {
+        return accumulator;
+    }
+
+private:
+    void consume()
+    {
+        auto last_report = std::chrono::steady_clock::now();
+
+        for (;;)
+        {
+            // Must be read before draining, otherwise records pushed right before finish() could be lost
+            bool done = producers_done.load(std::memory_order_acquire);
+
+            bool got_any = false;
+            Cycle_record record;
+            for (auto& channel : channels)
+            {
+                while (channel->queue.pop(record))
+                {
+                    accumulator.add(record.cost, record.clients);
+                    got_any = true;
+                }
+            }
+
+            if (target_relative_error > 0 && accumulator.n >= min_cycles && !stop.load(std::memory_order_relaxed))
+            {
+                auto [lower, upper] = accumulator.confidence_interval(confidence_level);
+                if ((upper - lower) / 2 <= target_relative_error * std::abs(accumulator.value()))
+                    stop.store(true, std::memory_order_relaxed);
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (on_report && now - last_report >= report_period)
+            {
+                on_report(get_estimate());
+                last_report = now;
+            }
+
+            if (done)
+                break;
+            if (!got_any)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        if (on_report)
+            on_report(get_estimate());
+    }
+};
+
+#endif // __PIPELINE_H__
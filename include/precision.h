@@ -0,0 +1,148 @@
+#ifndef __PRECISION_H__
+#define __PRECISION_H__
+
+// Accuracy of a simulation with reduced precision of clocks (Basic_system<float>) against the FP one.
+// Both run the same replications with the same streams; differences are shown in units of the
+// half-width of the 95% confidence interval of the FP run, so values well below 1 mean that
+// the error of precision is hidden by the simulation noise
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include "system.h"
+
+
+using FP = double;
+
+
+struct Precision_report
+{
+    struct Row
+    {
+        std::string name;
+        FP reference;    // FP clocks
+        FP value;        // Reduced precision clocks
+        FP half_width;   // Of 95% confidence interval of reference
+    };
+
+    std::vector<Row> rows;
+    FP reference_seconds = 0;
+    FP seconds = 0;
+
+    void print() const
+    {
+        std::cout << "\n======= PRECISION =======\n";
+        std::cout << "Value\t\t\tDouble\t\tReduced\t\tDifference / CI half-width\n";
+        for (const Row& row : rows)
+            std::cout << row.name << (row.name.size() < 8 ? "\t\t\t" : row.name.size() < 16 ? "\t\t" : "\t")
+                      << row.reference << "\t" << row.value << "\t" << std::abs(row.value - row.reference) / row.half_width << '\n';
+        std::cout << "Time: " << reference_seconds << " s double, " << seconds << " s reduced\n";
+        std::cout << "=========================\n";
+    }
+};
+
+
+// Per-replication totals that are compared
+struct Precision_totals
+{
+    Regenerative_accumulator cycles;
+    std::vector<FP> cycle_durations;
+    FP interarrival_sum = 0;
+    FP interarrival_squares = 0;
+    size_t interarrivals = 0;
+    FP downtime = 0;
+    FP seconds = 0;
+
+    template <typename Real>
+    void add(const typename Basic_system<Real>::Statistics& stat, FP seconds)
+    {
+        for (size_t c = 0; c < stat.cycle_cost_value.size(); ++c)
+            cycles.add(stat.cycle_cost_value[c], FP(stat.cycle_male_arrivals[c] + stat.cycle_female_arrivals[c]));
+        cycle_durations.insert(cycle_durations.end(), stat.cycle_durations.begin(), stat.cycle_durations.end());
+        for (Real x : stat.male_interarrival_times)
+        {
+            interarrival_sum += x;
+            interarrival_squares += FP(x) * x;
+        }
+        interarrivals += stat.male_interarrival_times.size();
+        downtime += stat.downtime;
+        this->seconds += seconds;
+    }
+};
+
+
+template <typename Real = float>
+Precision_report compare_precision(const System& system, size_t replications)
+{
+    System reference = system;
+    Basic_system<Real> reduced(system);
+    std::vector<RngStream> streams(replications);
+    std::vector<Precision_totals> reference_totals(replications), reduced_totals(replications);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < replications; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        System::Statistics reference_stat = reference.run(streams[i]);
+        auto middle = std::chrono::steady_clock::now();
+        typename Basic_system<Real>::Statistics reduced_stat = reduced.run(streams[i]);
+        auto end = std::chrono::steady_clock::now();
+
+        reference_totals[i].template add<FP>(reference_stat, std::chrono::duration<FP>(middle - start).count());
+        reduced_totals[i].template add<Real>(reduced_stat, std::chrono::duration<FP>(end - middle).count());
+    }
+
+    Precision_report report;
+    if (replications == 0)
+        return report;
+
+    // Downtime fraction is compared over replications, they are the independent units
+    std::vector<FP> downtime_fractions(replications);
+    for (size_t i = 0; i < replications; ++i)
+        downtime_fractions[i] = reference_totals[i].downtime / system.get_time();
+
+    for (size_t i = 1; i < replications; ++i)
+        for (auto* totals : {&reference_totals, &reduced_totals})
+        {
+            Precision_totals& total = (*totals)[0];
+            const Precision_totals& r = (*totals)[i];
+            total.cycles.merge(r.cycles);
+            total.cycle_durations.insert(total.cycle_durations.end(), r.cycle_durations.begin(), r.cycle_durations.end());
+            total.interarrival_sum += r.interarrival_sum;
+            total.interarrival_squares += r.interarrival_squares;
+            total.interarrivals += r.interarrivals;
+            total.downtime += r.downtime;
+            total.seconds += r.seconds;
+        }
+
+    const Precision_totals& a = reference_totals[0];
+    const Precision_totals& b = reduced_totals[0];
+    FP z = 1.959963984540054;
+
+    std::array<FP, 2> interval = a.cycles.confidence_interval(0.95);
+    report.rows.push_back({"Ratio estimate", a.cycles.value(), b.cycles.value(), (interval[1] - interval[0]) / 2});
+
+    FP duration_mean = ::mean(a.cycle_durations);
+    FP duration_half_width = z * std::sqrt(variance(a.cycle_durations, duration_mean) / a.cycle_durations.size());
+    report.rows.push_back({"Cycle duration", duration_mean, ::mean(b.cycle_durations), duration_half_width});
+
+    FP n = FP(a.interarrivals);
+    FP interarrival_mean = a.interarrival_sum / n;
+    FP interarrival_variance = (a.interarrival_squares - a.interarrival_sum * interarrival_mean) / (n - 1);
+    report.rows.push_back({"Male interarrival", interarrival_mean, b.interarrival_sum / FP(b.interarrivals),
+                           z * std::sqrt(interarrival_variance / n)});
+
+    FP total_time = system.get_time() * replications;
+    FP downtime_mean = ::mean(downtime_fractions);
+    report.rows.push_back({"Downtime fraction", a.downtime / total_time, b.downtime / total_time,
+                           z * std::sqrt(variance(downtime_fractions, downtime_mean) / replications)});
+
+    report.reference_seconds = a.seconds;
+    report.seconds = b.seconds;
+    return report;
+}
+
+#endif // __PRECISION_H__
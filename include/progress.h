@@ -0,0 +1,232 @@
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+// Progress of running simulations published in a memory-mapped file, one slot per thread.
+// The simulating thread is the only writer of its slot and never waits: it bumps the slot's sequence
+// to an odd value, writes the data and bumps it to even again (seqlock). A monitor in another process
+// copies the slot and retries if the sequence was odd or changed meanwhile
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "statistics.h"
+
+
+using FP = double;
+
+
+struct Progress_data
+{
+    FP simulated_time = 0;    // Model time of the current run
+    FP end_time = 0;          // Model time the current run ends at
+    uint64_t events = 0;      // Events of all runs of the slot
+    uint64_t runs = 0;        // Finished runs
+    FP events_per_second = 0;
+    FP updated = 0;           // Seconds since epoch of the last update; a stuck run stops updating it
+    Regenerative_accumulator cycles;  // Cycles of all runs of the slot
+};
+
+struct Progress_slot
+{
+    alignas(64) std::atomic<uint64_t> sequence{0};
+    Progress_data data;
+
+    void publish(const Progress_data& value)
+    {
+        uint64_t s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(static_cast<void*>(&data), &value, sizeof(Progress_data));
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    Progress_data read() const
+    {
+        Progress_data value;
+        for (;;)
+        {
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::memcpy(static_cast<void*>(&value), &data, sizeof(Progress_data));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before)
+                return value;
+        }
+    }
+};
+
+struct Progress_header
+{
+    char magic[8];
+    uint64_t slots;
+};
+
+constexpr char progress_magic[8] = {'S', 'Y', 'S', 'P', 'R', 'O', 'G', '1'};
+
+
+// File with a header and `slots` slots mapped into memory. Writers create it, monitors open it read-only
+class Progress_board
+{
+    void* memory = nullptr;
+    size_t bytes = 0;
+    size_t slots = 0;
+
+public:
+    // Creates (or truncates) the file
+    Progress_board(const std::string& path, size_t slots): slots(slots)
+    {
+        bytes = sizeof(Progress_header) + slots * sizeof(Progress_slot);
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, bytes) != 0)
+        {
+            std::cerr << "ERROR: cannot create progress file " << path << ".\n";
+            if (fd >= 0) ::close(fd);
+            return;
+        }
+        memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            std::cerr << "ERROR: cannot map progress file " << path << ".\n";
+            memory = nullptr;
+            return;
+        }
+#else
+        std::cerr << "WARNING: progress file " << path << " is not supported on this platform, progress is kept in memory.\n";
+        memory = ::operator new(bytes);
+#endif
+        Progress_header* header = new (memory) Progress_header{};
+        std::memcpy(header->magic, progress_magic, sizeof(progress_magic));
+        for (size_t i = 0; i < slots; ++i)
+            new (&slot(i)) Progress_slot();
+        header->slots = slots;  // Written last, so a monitor never sees slots that are not constructed
+    }
+
+    // Opens a file created by another process for reading
+    explicit Progress_board(const std::string& path)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Progress_header))
+        {
+            std::cerr << "ERROR: cannot open progress file " << path << ".\n";
+            if (fd >= 0) ::close(fd);
+            return;
+        }
+        bytes = info.st_size;
+        memory = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            memory = nullptr;
+            return;
+        }
+
+        const Progress_header* header = static_cast<const Progress_header*>(memory);
+        if (std::memcmp(header->magic, progress_magic, sizeof(progress_magic)) != 0)
+        {
+            std::cerr << "ERROR: " << path << " is not a progress file.\n";
+            munmap(memory, bytes);
+            memory = nullptr;
+            return;
+        }
+        slots = std::min<size_t>(header->slots, (bytes - sizeof(Progress_header)) / sizeof(Progress_slot));
+#else
+        std::cerr << "ERROR: progress files are not supported on this platform.\n";
+#endif
+    }
+
+    Progress_board(const Progress_board&) = delete;
+    Progress_board& operator=(const Progress_board&) = delete;
+
+    ~Progress_board()
+    {
+        if (!memory)
+            return;
+#if defined(__unix__) || defined(__APPLE__)
+        munmap(memory, bytes);
+#else
+        ::operator delete(memory);
+#endif
+    }
+
+    bool is_open() const
+    {
+        return memory != nullptr;
+    }
+
+    size_t size() const
+    {
+        return slots;
+    }
+
+    Progress_slot& slot(size_t i)
+    {
+        return reinterpret_cast<Progress_slot*>(static_cast<char*>(memory) + sizeof(Progress_header))[i];
+    }
+
+    const Progress_slot& slot(size_t i) const
+    {
+        return reinterpret_cast<const Progress_slot*>(static_cast<const char*>(memory) + sizeof(Progress_header))[i];
+    }
+};
+
+
+inline FP seconds_since_epoch()
+{
+    return std::chrono::duration<FP>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Prints progress of all slots of the file every `period` seconds; stops after `rounds` prints (0 - never)
+void monitor_progress(const std::string& path, FP period = 1, size_t rounds = 0)
+{
+    Progress_board board(path);
+    if (!board.is_open())
+        return;
+
+    for (size_t round = 0; rounds == 0 || round < rounds; ++round)
+    {
+        Regenerative_accumulator total;
+        FP now = seconds_since_epoch();
+
+        std::cout << "\n======= PROGRESS =======\n";
+        std::cout << "Slot\tRuns\tTime\t\tEvents\t\tEvents/s\tCycles\tIdle, s\n";
+        for (size_t i = 0; i < board.size(); ++i)
+        {
+            Progress_data data = board.slot(i).read();
+            if (data.updated == 0)
+                continue;
+            total.merge(data.cycles);
+            std::cout << i << '\t' << data.runs << '\t' << data.simulated_time << " / " << data.end_time << '\t'
+                      << data.events << '\t' << data.events_per_second << '\t' << data.cycles.n << '\t' << now - data.updated << '\n';
+        }
+        if (total.n > 1)
+        {
+            auto [lower, upper] = total.confidence_interval();
+            std::cout << "Estimate: " << total.value() << " [" << lower << ", " << upper << "] from " << total.n << " cycles\n";
+        }
+        std::cout << "========================" << std::endl;
+
+        std::this_thread::sleep_for(std::chrono::duration<FP>(period));
+    }
+}
+
+#endif // __PROGRESS_H__
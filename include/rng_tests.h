@@ -0,0 +1,389 @@
+#ifndef __RNG_TESTS_H__
+#define __RNG_TESTS_H__
+
+// Statistical test battery for uniform generators: frequency, serial, gap, birthday spacings and collision tests
+// of every stream, and correlation between neighbouring streams. Streams are tested in parallel, each in one pass
+// over blocks of its numbers. Per-stream p-values of every test are checked for uniformity (second level KS test).
+//
+// A generator is given by a factory of sources: source(i) fills buffers with the numbers of stream i from its start.
+// Any backend that produces numbers in blocks (batched or vectorized) can be tested through it
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <omp.h>
+#include "system.h"
+
+
+using FP = double;
+
+
+// Fills buffer with next n numbers of a stream
+using Uniform_source = std::function<void(FP* buffer, size_t n)>;
+
+// Returns a new source at the start of stream i; called from many threads at once
+using Source_factory = std::function<Uniform_source(size_t i)>;
+
+
+// Streams created one after another by the RngStream constructor
+Source_factory rng_stream_sources(size_t count)
+{
+    std::vector<RngStream> streams(count);
+    return [streams](size_t i) -> Uniform_source
+    {
+        return [stream = streams[i]](FP* buffer, size_t n) mutable
+        {
+            for (size_t k = 0; k < n; ++k)
+                buffer[k] = stream.RandU01();
+        };
+    };
+}
+
+// Consecutive substreams of one stream
+Source_factory rng_substream_sources()
+{
+    RngStream first;
+    return [first](size_t i) -> Uniform_source
+    {
+        RngStream stream = first;
+        stream.AdvanceSubstream(i);
+        return [stream](FP* buffer, size_t n) mutable
+        {
+            for (size_t k = 0; k < n; ++k)
+                buffer[k] = stream.RandU01();
+        };
+    };
+}
+
+
+// Two-sided p-value of an observed Poisson count k with mean lambda
+FP poisson_p_value(uint64_t k, FP lambda)
+{
+    FP at_most = regularized_gamma_q(k + 1.0, lambda);
+    FP at_least = k == 0 ? 1 : 1 - regularized_gamma_q(FP(k), lambda);
+    return std::min(FP(1), 2 * std::min(at_most, at_least));
+}
+
+FP chi_square_statistic(const std::vector<uint64_t>& observed, const std::vector<FP>& expected)
+{
+    FP x2 = 0;
+    for (size_t i = 0; i < observed.size(); ++i)
+        x2 += (observed[i] - expected[i]) * (observed[i] - expected[i]) / expected[i];
+    return x2;
+}
+
+
+// Counts of u in 1024 equal bins
+struct Frequency_test
+{
+    static constexpr size_t bins = 1024;
+    std::vector<uint64_t> counts = std::vector<uint64_t>(bins, 0);
+    uint64_t n = 0;
+
+    void add(const FP* u, size_t size)
+    {
+        for (size_t k = 0; k < size; ++k)
+            ++counts[std::min(static_cast<size_t>(u[k] * bins), bins - 1)];
+        n += size;
+    }
+
+    FP p_value() const
+    {
+        return chi_square_p_value(chi_square_statistic(counts, std::vector<FP>(bins, FP(n) / bins)), bins - 1);
+    }
+};
+
+// Counts of non-overlapping pairs in 64 x 64 cells
+struct Serial_test
+{
+    static constexpr size_t d = 64;
+    std::vector<uint64_t> counts = std::vector<uint64_t>(d * d, 0);
+    uint64_t n = 0;
+
+    // Sizes of blocks are even, so pairs never cross blocks
+    void add(const FP* u, size_t size)
+    {
+        for (size_t k = 0; k + 1 < size; k += 2)
+        {
+            size_t x = std::min(static_cast<size_t>(u[k] * d), d - 1);
+            size_t y = std::min(static_cast<size_t>(u[k + 1] * d), d - 1);
+            ++counts[x * d + y];
+        }
+        n += size / 2;
+    }
+
+    FP p_value() const
+    {
+        return chi_square_p_value(chi_square_statistic(counts, std::vector<FP>(d * d, FP(n) / (d * d))), d * d - 1);
+    }
+};
+
+// Lengths of gaps between values in [0, 1/16); gaps of 64 and more are counted together
+struct Gap_test
+{
+    static constexpr FP p = 1.0 / 16;
+    static constexpr size_t classes = 64;
+    std::vector<uint64_t> counts = std::vector<uint64_t>(classes + 1, 0);
+    size_t gap = 0;
+
+    void add(const FP* u, size_t size)
+    {
+        for (size_t k = 0; k < size; ++k)
+        {
+            if (u[k] < p)
+            {
+                ++counts[std::min(gap, classes)];
+                gap = 0;
+            }
+            else
+                ++gap;
+        }
+    }
+
+    FP p_value() const
+    {
+        uint64_t gaps = 0;
+        for (uint64_t c : counts)
+            gaps += c;
+
+        std::vector<FP> expected(classes + 1);
+        for (size_t r = 0; r < classes; ++r)
+            expected[r] = gaps * p * std::pow(1 - p, FP(r));
+        expected[classes] = gaps * std::pow(1 - p, FP(classes));
+        return chi_square_p_value(chi_square_statistic(counts, expected), classes);
+    }
+};
+
+// Marsaglia's birthday spacings: m = 512 birthdays in a year of 2^24 days, number of repeated spacings
+// is Poisson with mean m^3 / (4 * 2^24) = 2 per sample. Sorting costs more than generation,
+// so only the first m numbers of every block are used
+struct Birthday_spacings_test
+{
+    static constexpr size_t m = 512;
+    static constexpr FP days = 16777216.0;
+    std::vector<uint32_t> birthdays;
+    std::vector<uint32_t> spacings = std::vector<uint32_t>(m);
+    uint64_t repeated = 0;
+    uint64_t samples = 0;
+
+    void add(const FP* u, size_t size)
+    {
+        for (size_t k = 0; k < std::min(size, m); ++k)
+        {
+            birthdays.push_back(static_cast<uint32_t>(u[k] * days));
+            if (birthdays.size() < m)
+                continue;
+
+            std::sort(birthdays.begin(), birthdays.end());
+            spacings[0] = birthdays[0];
+            for (size_t i = 1; i < m; ++i)
+                spacings[i] = birthdays[i] - birthdays[i - 1];
+            std::sort(spacings.begin(), spacings.end());
+            for (size_t i = 1; i < m; ++i)
+                repeated += spacings[i] == spacings[i - 1];
+
+            birthdays.clear();
+            ++samples;
+        }
+    }
+
+    FP p_value() const
+    {
+        return poisson_p_value(repeated, samples * FP(m) * m * m / (4 * days));
+    }
+};
+
+// Knuth's collision test: 2^14 balls into 2^20 urns, about 128 collisions per sample
+struct Collision_test
+{
+    static constexpr size_t urns = 1 << 20;
+    static constexpr size_t balls = 1 << 14;
+    std::vector<uint8_t> occupied = std::vector<uint8_t>(urns, 0);
+    std::vector<uint32_t> touched;
+    uint64_t collisions = 0;
+    uint64_t samples = 0;
+
+    void add(const FP* u, size_t size)
+    {
+        for (size_t k = 0; k < size; ++k)
+        {
+            uint32_t urn = std::min(static_cast<uint32_t>(u[k] * urns), uint32_t(urns - 1));
+            if (occupied[urn])
+                ++collisions;
+            else
+            {
+                occupied[urn] = 1;
+                touched.push_back(urn);
+            }
+            if (++ball < balls)
+                continue;
+
+            for (uint32_t t : touched)
+                occupied[t] = 0;
+            touched.clear();
+            ball = 0;
+            ++samples;
+        }
+    }
+
+    // Expected collisions per sample are balls - urns + urns * (1 - 1 / urns)^balls; their count is nearly Poisson
+    FP p_value() const
+    {
+        FP expected = balls - FP(urns) + urns * std::exp(balls * std::log1p(-1.0 / urns));
+        return poisson_p_value(collisions, samples * expected);
+    }
+
+private:
+    size_t ball = 0;
+};
+
+
+struct Rng_test_settings
+{
+    size_t streams = 64;
+    uint64_t numbers_per_stream = 1 << 24;
+    uint64_t correlation_length = 1 << 20;  // Numbers of every pair of neighbouring streams
+};
+
+struct Rng_test_report
+{
+    static constexpr size_t tests = 6;
+    static constexpr std::array<const char*, tests> names{"Frequency", "Serial", "Gap", "Birthday spacings", "Collision", "Correlation"};
+
+    // p_values[t][i] - p-value of test t on stream i (correlation: on streams i and i + 1)
+    std::array<std::vector<FP>, tests> p_values;
+
+    // Second level test: p-values of a sound generator are uniform on [0, 1]
+    FP uniformity_p_value(size_t test) const
+    {
+        const std::vector<FP>& p = p_values[test];
+        if (p.empty())
+            return 1;
+        return kolmogorov_p_value(kolmogorov_smirnov_statistic(p, [](FP x) { return std::clamp(x, FP(0), FP(1)); }), p.size());
+    }
+
+    FP min_p_value(size_t test) const
+    {
+        const std::vector<FP>& p = p_values[test];
+        return p.empty() ? 1 : *std::min_element(p.begin(), p.end());
+    }
+
+    // Fails if uniformity of some test is rejected, or its smallest p-value is below significance / number of streams
+    bool passed(FP significance) const
+    {
+        for (size_t t = 0; t < tests; ++t)
+            if (uniformity_p_value(t) < significance || min_p_value(t) * p_values[t].size() < significance)
+                return false;
+        return true;
+    }
+
+    void print(const std::string& title, FP significance = 0.001) const
+    {
+        std::cout << "\n======= RNG TESTS: " << title << " =======\n";
+        std::cout << "Test\t\t\tStreams\tMin p\t\tUniformity p\n";
+        for (size_t t = 0; t < tests; ++t)
+        {
+            std::string name = names[t];
+            std::cout << name << (name.size() < 8 ? "\t\t\t" : name.size() < 16 ? "\t\t" : "\t")
+                      << p_values[t].size() << '\t' << min_p_value(t) << "\t" << uniformity_p_value(t) << '\n';
+        }
+        std::cout << (passed(significance) ? "PASSED" : "FAILED") << " at significance " << significance << '\n';
+        std::cout << "==================================\n";
+    }
+};
+
+
+Rng_test_report run_rng_tests(const Source_factory& sources, const Rng_test_settings& settings = Rng_test_settings())
+{
+    const size_t block = 1 << 12;
+    Rng_test_report report;
+    for (size_t t = 0; t < Rng_test_report::tests; ++t)
+        report.p_values[t].assign(settings.streams, NAN);
+    report.p_values[5].resize(settings.streams > 0 ? settings.streams - 1 : 0);
+
+    #pragma omp parallel
+    {
+        std::vector<FP> buffer(block);
+        std::vector<FP> other(block);
+
+        #pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < settings.streams; ++i)
+        {
+            Uniform_source source = sources(i);
+            Frequency_test frequency;
+            Serial_test serial;
+            Gap_test gap;
+            Birthday_spacings_test birthday;
+            Collision_test collision;
+
+            for (uint64_t done = 0; done < settings.numbers_per_stream; done += block)
+            {
+                size_t size = static_cast<size_t>(std::min<uint64_t>(block, settings.numbers_per_stream - done)) & ~size_t(1);
+                if (size == 0)
+                    break;
+                source(buffer.data(), size);
+                frequency.add(buffer.data(), size);
+                serial.add(buffer.data(), size);
+                gap.add(buffer.data(), size);
+                birthday.add(buffer.data(), size);
+                collision.add(buffer.data(), size);
+            }
+
+            report.p_values[0][i] = frequency.p_value();
+            report.p_values[1][i] = serial.p_value();
+            report.p_values[2][i] = gap.p_value();
+            report.p_values[3][i] = birthday.p_value();
+            report.p_values[4][i] = collision.p_value();
+        }
+
+        // Pearson correlation r of aligned numbers of streams i and i + 1; sqrt(n) * r is standard normal
+        #pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < report.p_values[5].size(); ++i)
+        {
+            Uniform_source first = sources(i);
+            Uniform_source second = sources(i + 1);
+            FP sum_x = 0, sum_y = 0, sum_xx = 0, sum_yy = 0, sum_xy = 0;
+
+            for (uint64_t done = 0; done < settings.correlation_length; done += block)
+            {
+                size_t size = static_cast<size_t>(std::min<uint64_t>(block, settings.correlation_length - done));
+                first(buffer.data(), size);
+                second(other.data(), size);
+                for (size_t k = 0; k < size; ++k)
+                {
+                    sum_x += buffer[k];
+                    sum_y += other[k];
+                    sum_xx += buffer[k] * buffer[k];
+                    sum_yy += other[k] * other[k];
+                    sum_xy += buffer[k] * other[k];
+                }
+            }
+
+            FP n = FP(settings.correlation_length);
+            FP covariance = sum_xy - sum_x * sum_y / n;
+            FP r = covariance / std::sqrt((sum_xx - sum_x * sum_x / n) * (sum_yy - sum_y * sum_y / n));
+            report.p_values[5][i] = 2 * (1 - standard_normal_cdf(std::abs(r) * std::sqrt(n)));
+        }
+    }
+
+    return report;
+}
+
+// Tests streams and substreams of RngStream; returns false if some test fails
+bool test_rng_streams(const Rng_test_settings& settings = Rng_test_settings(), FP significance = 0.001)
+{
+    Rng_test_report streams = run_rng_tests(rng_stream_sources(settings.streams), settings);
+    streams.print("streams", significance);
+
+    Rng_test_report substreams = run_rng_tests(rng_substream_sources(), settings);
+    substreams.print("substreams", significance);
+
+    return streams.passed(significance) && substreams.passed(significance);
+}
+
+#endif // __RNG_TESTS_H__
@@ -0,0 +1,211 @@
+#ifndef __SKETCH_H__
+#define __SKETCH_H__
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+
+
+using FP = double;
+
+
+// Merging t-digest: streaming quantile estimator with bounded memory.
+// Centroids are small near q = 0 and q = 1, so tail quantiles (p99, p99.9) are accurate.
+// Larger compression gives more centroids (about compression / 2) and better accuracy
+class Quantile_sketch
+{
+public:
+    struct Centroid
+    {
+        FP mean;
+        FP weight;
+    };
+
+private:
+    static constexpr FP pi = 3.14159265358979323846;
+
+    FP compression;
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> buffer;  // Values that are not merged into centroids yet
+    FP total_weight = 0;           // Weight of centroids only
+    FP min_value = std::numeric_limits<FP>::infinity();
+    FP max_value = -std::numeric_limits<FP>::infinity();
+
+public:
+    Quantile_sketch(FP compression = 200): compression(compression) {}
+
+    void add(FP x, FP weight = 1)
+    {
+        buffer.push_back({x, weight});
+        min_value = std::min(min_value, x);
+        max_value = std::max(max_value, x);
+        if (buffer.size() >= buffer_limit())
+            flush();
+    }
+
+    void merge(const Quantile_sketch& other)
+    {
+        buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+        buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+        flush();
+    }
+
+    // Merges buffered values into centroids
+    void flush()
+    {
+        if (buffer.empty())
+            return;
+
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        std::sort(buffer.begin(), buffer.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+        total_weight = 0;
+        for (const Centroid& c : buffer)
+            total_weight += c.weight;
+
+        centroids.clear();
+        Centroid current = buffer[0];
+        FP weight_before = 0;
+        FP q_limit = q_of_k(k_of_q(0) + 1);
+
+        for (size_t i = 1; i < buffer.size(); ++i)
+        {
+            const Centroid& next = buffer[i];
+            if ((weight_before + current.weight + next.weight) / total_weight <= q_limit)
+            {
+                current.weight += next.weight;
+                current.mean += (next.mean - current.mean) * next.weight / current.weight;
+            }
+            else
+            {
+                centroids.push_back(current);
+                weight_before += current.weight;
+                q_limit = q_of_k(k_of_q(weight_before / total_weight) + 1);
+                current = next;
+            }
+        }
+        centroids.push_back(current);
+        buffer.clear();
+    }
+
+    FP count() const
+    {
+        FP weight = total_weight;
+        for (const Centroid& c : buffer)
+            weight += c.weight;
+        return weight;
+    }
+
+    FP quantile(FP q) const
+    {
+        if (!buffer.empty())
+        {
+            Quantile_sketch flushed = *this;
+            flushed.flush();
+            return flushed.quantile(q);
+        }
+        if (centroids.empty())
+            return std::numeric_limits<FP>::quiet_NaN();
+        if (centroids.size() == 1)
+            return centroids[0].mean;
+
+        FP target = std::clamp(q, FP(0), FP(1)) * total_weight;
+
+        // Between minimum and center of the first centroid
+        const Centroid& first = centroids.front();
+        if (target < first.weight / 2)
+            return min_value + (first.mean - min_value) * target / (first.weight / 2);
+
+        // Between centers of adjacent centroids
+        FP center = first.weight / 2;
+        for (size_t i = 0; i + 1 < centroids.size(); ++i)
+        {
+            FP next_center = center + (centroids[i].weight + centroids[i + 1].weight) / 2;
+            if (target < next_center)
+                return centroids[i].mean + (centroids[i + 1].mean - centroids[i].mean) * (target - center) / (next_center - center);
+            center = next_center;
+        }
+
+        // Between center of the last centroid and maximum
+        const Centroid& last = centroids.back();
+        FP rest = total_weight - center;
+        return last.mean + (max_value - last.mean) * std::min(FP(1), (target - center) / rest);
+    }
+
+    FP min() const
+    {
+        return min_value;
+    }
+
+    FP max() const
+    {
+        return max_value;
+    }
+
+    size_t size() const
+    {
+        return centroids.size() + buffer.size();
+    }
+
+    // Centroids and unmerged buffer are saved as they are, so a sketch that is read back
+    // flushes at the same values and gives the same quantiles as one that was never saved
+    void write(std::ostream& out) const
+    {
+        uint64_t n = centroids.size(), m = buffer.size();
+        out.write(reinterpret_cast<const char*>(&compression), sizeof(compression));
+        out.write(reinterpret_cast<const char*>(&min_value), sizeof(min_value));
+        out.write(reinterpret_cast<const char*>(&max_value), sizeof(max_value));
+        out.write(reinterpret_cast<const char*>(&total_weight), sizeof(total_weight));
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char*>(centroids.data()), n * sizeof(Centroid));
+        out.write(reinterpret_cast<const char*>(&m), sizeof(m));
+        out.write(reinterpret_cast<const char*>(buffer.data()), m * sizeof(Centroid));
+    }
+
+    void read(std::istream& in)
+    {
+        uint64_t n = 0, m = 0;
+        in.read(reinterpret_cast<char*>(&compression), sizeof(compression));
+        in.read(reinterpret_cast<char*>(&min_value), sizeof(min_value));
+        in.read(reinterpret_cast<char*>(&max_value), sizeof(max_value));
+        in.read(reinterpret_cast<char*>(&total_weight), sizeof(total_weight));
+        in.read(reinterpret_cast<char*>(&n), sizeof(n));
+        if (!in)
+            return;
+
+        centroids.resize(n);
+        in.read(reinterpret_cast<char*>(centroids.data()), n * sizeof(Centroid));
+        in.read(reinterpret_cast<char*>(&m), sizeof(m));
+        if (!in)
+            return;
+
+        buffer.resize(m);
+        in.read(reinterpret_cast<char*>(buffer.data()), m * sizeof(Centroid));
+    }
+
+private:
+    size_t buffer_limit() const
+    {
+        return static_cast<size_t>(5 * compression);
+    }
+
+    // Scale function k1: centroid may cover at most one unit of k
+    FP k_of_q(FP q) const
+    {
+        return compression / (2 * pi) * std::asin(2 * q - 1);
+    }
+
+    FP q_of_k(FP k) const
+    {
+        if (k >= compression / 4)
+            return 1;
+        return (std::sin(k * 2 * pi / compression) + 1) / 2;
+    }
+};
+
+#endif // __SKETCH_H__
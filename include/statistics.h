@@ -5,6 +5,8 @@
 #include <numeric>
 #include <cmath>
 #include <array>
+#include <algorithm>
+#include <functional>
 #include "system.h"
 
 
@@ -81,6 +83,174 @@ std::array<FP, 2> regenerative_estimation(const std::vector<FP>& costs_per_cycle
     return {r_value - margin_of_error, r_value + margin_of_error};
 }
 
+FP standard_normal_cdf(FP x)
+{
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+// sup |F_n(x) - F(x)| for empirical distribution function of data
+FP kolmogorov_smirnov_statistic(std::vector<FP> data, const std::function<FP(FP)>& cdf)
+{
+    std::sort(data.begin(), data.end());
+    size_t n = data.size();
+
+    FP d = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        FP f = cdf(data[i]);
+        d = std::max(d, std::max(FP(i + 1) / n - f, f - FP(i) / n));
+    }
+    return d;
+}
+
+// Asymptotic p-value of KS statistic d for sample size n (Stephens' correction for finite n)
+FP kolmogorov_p_value(FP d, size_t n)
+{
+    FP sqrt_n = std::sqrt(FP(n));
+    FP t = (sqrt_n + 0.12 + 0.11 / sqrt_n) * d;
+
+    // Q(t) = 2 * sum (-1)^(k-1) exp(-2 k^2 t^2)
+    FP sum = 0;
+    for (int k = 1; k <= 100; ++k)
+    {
+        FP term = std::exp(-2.0 * k * k * t * t);
+        sum += (k % 2 ? term : -term);
+        if (term < 1e-16)
+            break;
+    }
+    return std::clamp(2 * sum, FP(0), FP(1));
+}
+
+// Running sums for regenerative ratio estimator r = E[cost per cycle] / E[clients per cycle].
+// Accumulators of different threads or runs can be merged
+struct Regenerative_accumulator
+{
+    size_t n = 0;
+    FP sum_of_costs = 0;
+    FP sum_of_costs_squares = 0;
+    FP sum_of_num_clients = 0;
+    FP sum_of_num_clients_squares = 0;
+    FP sum_of_products = 0;
+
+    void add(FP cost, FP clients)
+    {
+        ++n;
+        sum_of_costs += cost;
+        sum_of_costs_squares += cost * cost;
+        sum_of_num_clients += clients;
+        sum_of_num_clients_squares += clients * clients;
+        sum_of_products += cost * clients;
+    }
+
+    void merge(const Regenerative_accumulator& other)
+    {
+        n += other.n;
+        sum_of_costs += other.sum_of_costs;
+        sum_of_costs_squares += other.sum_of_costs_squares;
+        sum_of_num_clients += other.sum_of_num_clients;
+        sum_of_num_clients_squares += other.sum_of_num_clients_squares;
+        sum_of_products += other.sum_of_products;
+    }
+
+    FP value() const
+    {
+        return sum_of_costs / sum_of_num_clients;
+    }
+
+    // Returns {lower, upper} bounds of asymptotic normal confidence interval
+    std::array<FP, 2> confidence_interval(FP confidence_level = 0.95) const
+    {
+        FP r_value = value();
+        if (n < 2)
+            return {r_value, r_value};
+
+        FP m = FP(n);
+        FP S11 = (sum_of_costs_squares - sum_of_costs * sum_of_costs / m) / (m - 1);
+        FP S22 = (sum_of_num_clients_squares - sum_of_num_clients * sum_of_num_clients / m) / (m - 1);
+        FP S12 = (sum_of_products - sum_of_costs * sum_of_num_clients / m) / (m - 1);
+        FP S = std::sqrt(std::max(FP(0), S11 - 2 * r_value * S12 + (r_value * r_value) * S22));
+
+        FP quantile = inverse_standard_normal(1 - (1 - confidence_level) / 2);
+        FP margin_of_error = quantile * S / (sum_of_num_clients / m * std::sqrt(m));
+        return {r_value - margin_of_error, r_value + margin_of_error};
+    }
+};
+
+// Derivatives of r = E[cost per cycle] / E[clients per cycle] with respect to model parameters by likelihood ratio
+// (score function) method. For every cycle it gets cost C, clients A and scores S_k = d log(likelihood of cycle) / d theta_k.
+// Then dr/dtheta_k = (E[C S_k] - r E[A S_k]) / E[A], and its confidence interval is obtained by delta method
+struct Gradient_accumulator
+{
+    static constexpr size_t parameters = 3;
+    static constexpr size_t dimension = 2 + 2 * parameters;  // C, A, C S_1, A S_1, C S_2, A S_2, ...
+
+    size_t n = 0;
+    std::array<FP, dimension> sums{};
+    std::array<FP, dimension * dimension> products{};
+
+    void add(FP cost, FP clients, const std::array<FP, parameters>& scores)
+    {
+        std::array<FP, dimension> v;
+        v[0] = cost;
+        v[1] = clients;
+        for (size_t k = 0; k < parameters; ++k)
+        {
+            v[2 + 2 * k] = cost * scores[k];
+            v[3 + 2 * k] = clients * scores[k];
+        }
+
+        ++n;
+        for (size_t i = 0; i < dimension; ++i)
+        {
+            sums[i] += v[i];
+            for (size_t j = 0; j < dimension; ++j)
+                products[i * dimension + j] += v[i] * v[j];
+        }
+    }
+
+    void merge(const Gradient_accumulator& other)
+    {
+        n += other.n;
+        for (size_t i = 0; i < dimension; ++i)
+            sums[i] += other.sums[i];
+        for (size_t i = 0; i < dimension * dimension; ++i)
+            products[i] += other.products[i];
+    }
+
+    // Returns {estimate, lower, upper} for derivative by parameter k
+    std::array<FP, 3> derivative(size_t k, FP confidence_level = 0.95) const
+    {
+        const size_t index[4] = {0, 1, 2 + 2 * k, 3 + 2 * k};
+        FP m[4];
+        for (size_t i = 0; i < 4; ++i)
+            m[i] = sums[index[i]] / n;
+
+        FP value = (m[2] - m[0] / m[1] * m[3]) / m[1];
+        if (n < 2)
+            return {value, value, value};
+
+        // Gradient of (m2 - m0 m3 / m1) / m1 with respect to (m0, m1, m2, m3)
+        FP gradient[4] = {
+            -m[3] / (m[1] * m[1]),
+            -m[2] / (m[1] * m[1]) + 2 * m[0] * m[3] / (m[1] * m[1] * m[1]),
+            1 / m[1],
+            -m[0] / (m[1] * m[1])
+        };
+
+        FP var = 0;
+        for (size_t i = 0; i < 4; ++i)
+            for (size_t j = 0; j < 4; ++j)
+            {
+                FP covariance = (products[index[i] * dimension + index[j]] - n * m[i] * m[j]) / (n - 1);
+                var += gradient[i] * gradient[j] * covariance;
+            }
+
+        FP quantile = inverse_standard_normal(1 - (1 - confidence_level) / 2);
+        FP margin_of_error = quantile * std::sqrt(std::max(FP(0), var) / n);
+        return {value, value - margin_of_error, value + margin_of_error};
+    }
+};
+
 FP inverse_standard_normal(FP p) {
     // Constants for the approximation
     const FP a1 = -3.969683028665376e+01;
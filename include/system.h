@@ -5,19 +5,26 @@
 #include <functional>
 #include <array>
 #include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <omp.h>
 #include "statistics.h"
+#include "distributions.h"
+#include "pipeline.h"
+#include "histogram.h"
+#include "sketch.h"
+#include "goodness_of_fit.h"
+#include "progress.h"
 #include "RngStream.h"
 
 
 using FP = double;
 
 
-FP generate_exponential(FP lambda, RngStream& rng) 
-{
-    FP u = rng.RandU01();
-    return -std::log(u) / lambda;
-}
-
 std::function<std::array<size_t, 3>(std::array<size_t, 3>)> default_conductor = [](std::array<size_t, 3> state)
 {
     if (state[2] != 0)
@@ -42,8 +49,34 @@ std::function<FP(std::array<size_t, 3>, FP)> default_cost_function = [](std::arr
     return (state[0] + state[1]) * time;
 };
 
-class System 
+// Statistics collected by the event loop. The set is a template argument of run, so the loop does not contain
+// the collection of anything else. Totals and downtime are always collected
+enum Collected : unsigned
 {
+    COLLECT_CYCLES = 1 << 0,         // cycle_cost_value, cycle_male_arrivals, cycle_female_arrivals
+    COLLECT_CYCLE_DETAILS = 1 << 1,  // cycle_durations, cycle_male_left, cycle_female_left
+    COLLECT_TRACES = 1 << 2,         // Interarrival times
+    COLLECT_SKETCHES = 1 << 3,
+    COLLECT_OCCUPANCY = 1 << 4,
+    COLLECT_GRADIENT = 1 << 5,
+    COLLECT_CLOCK_FIT = 1 << 6,      // If enabled by set_goodness_of_fit_bins
+    COLLECT_TIME_OF_DAY = 1 << 7,    // If enabled by set_time_of_day_statistics
+    COLLECT_ESTIMATOR = COLLECT_CYCLES,
+    COLLECT_ALL = ~0u
+};
+
+template <typename Real, size_t Lanes> class Lockstep_engine;
+
+// Model time, cost and statistics are accumulated in FP. Clocks of the event loop and samples of distributions
+// have type Real: with Real = float they take half the memory and bandwidth. Clocks hold residual times,
+// so they stay small however long the run is, and precision of float clocks does not degrade with model time
+template <typename Real = FP>
+class Basic_system 
+{
+    template <typename> friend class Basic_system;
+    template <typename, size_t> friend class Lockstep_engine;
+    friend bool validate_simulation(const Basic_system<>& system, size_t num_experiments, FP significance, size_t bins);
+
 public:
     struct Statistics;
     
@@ -64,56 +97,63 @@ private:
     FP l1, l2, mu;
     size_t male_queue_limit = UINT32_MAX;
     size_t female_queue_limit = UINT32_MAX;
+    std::array<size_t, 3> occupancy_limits{32, 32, 3};
+    FP sketch_compression = 200;
+    size_t goodness_of_fit_bins = 0;
+    Progress_board* progress = nullptr;  // Not owned
+    FP progress_period = 1;
+    size_t progress_first_slot = 0;  // Slot of thread 0
     std::function<FP(std::array<size_t, 3>, FP)> cost_function;
     Conductor conductor;
+    std::array<Distribution, 3> distributions;  // Time between events of MALE, FEMALE and SERVED clocks
+    std::array<Rate_function, 2> arrival_rates;  // If set, MALE or FEMALE arrivals are nonhomogeneous Poisson
+    FP time_of_day_period = 0;
+    size_t time_of_day_bins = 0;
+
+    // Conductor applied to every state within queue limits, built when limits are set.
+    // Entry of state (male, female, served) has index (male * (female_queue_limit + 1) + female) * (served_limit + 1) + served
+    struct Transition
+    {
+        uint32_t male;
+        uint32_t female;
+        uint32_t served;
+        uint8_t male_event;
+        uint8_t female_event;
+    };
+
+    static constexpr size_t max_transition_table_size = 1 << 20;
+    std::vector<Transition> transitions;
+    size_t served_limit = 0;
 
     struct State 
     {
         struct Timers
         {
-            std::array<FP, 3> clocks;
+            std::array<Real, 3> clocks;
 
-            // Returns {time to next event, event}
-            std::pair<FP, Event> get_event(const System& system, std::array<size_t, 3> state)
+            // Returns {time to next event, event}. male_event and female_event tell if an arriving 
+            // customer joins the queue (MALE, FEMALE) or leaves because it is full (MALE_LEFT, FEMALE_LEFT)
+            std::pair<Real, Event> get_event(Event male_event, Event female_event) const
             {
                 if (clocks[SERVED] == 0) // No one is in the system
                 {
                     if (clocks[MALE] < clocks[FEMALE]) 
-                    {
-                        if (state[MALE] < system.male_queue_limit)
-                            return {clocks[MALE], MALE};  // Male has come
-                        else 
-                            return {clocks[MALE], MALE_LEFT};
-                    }
+                        return {clocks[MALE], male_event};  // Male has come
                     else
-                    {
-                        if (state[FEMALE] < system.female_queue_limit)
-                            return {clocks[FEMALE], FEMALE};  // Female has come
-                        else 
-                            return {clocks[FEMALE], FEMALE_LEFT};
-                    }
+                        return {clocks[FEMALE], female_event};  // Female has come
                 }
 
                 //  Someone in the system can be served
                 if (clocks[MALE] < clocks[FEMALE] && clocks[MALE] < clocks[SERVED])
-                { 
-                    if (state[MALE] < system.male_queue_limit)
-                        return {clocks[MALE], MALE};  // Male has come
-                    else 
-                        return {clocks[MALE], MALE_LEFT};
-                }
+                    return {clocks[MALE], male_event};  // Male has come
                 else  if (clocks[FEMALE] < clocks[SERVED]) 
-                {
-                    if (state[FEMALE] < system.female_queue_limit)
-                        return {clocks[FEMALE], FEMALE};  // Female has come
-                    else 
-                        return {clocks[FEMALE], FEMALE_LEFT};
-                }
+                    return {clocks[FEMALE], female_event};  // Female has come
 
                 return {clocks[SERVED], SERVED};  // One person has been served
             }
 
-            void refresh(FP passed_time, const Event event, RngStream& rng, const System& system, const std::array<size_t, 3>& state) 
+            // now is the time of the event
+            void refresh(Real passed_time, FP now, const Event event, RngStream& rng, const Basic_system& system, const std::array<size_t, 3>& state) 
             {
                 // Set time for serving if 
                 // (First person has came in the system) OR (person has been served and there still someone in the system)
@@ -122,7 +162,7 @@ private:
                     clocks[FEMALE] -= passed_time;
                 }
                 if ((clocks[SERVED] == 0 || event == SERVED) && state[SERVED] != 0)
-                    clocks[SERVED] = generate_exponential(system.mu, rng);
+                    clocks[SERVED] = system.sample_clock(SERVED, now, rng);
                 // Refresh time for serving if we have to
                 else if (event != SERVED && clocks[SERVED] != 0)
                     clocks[SERVED] -= passed_time;
@@ -130,19 +170,17 @@ private:
                 else if (event == SERVED && state[SERVED] == 0)
                     clocks[SERVED] = 0;
 
-                auto [male_queue_limit, female_queue_limit] = system.get_queues_limits();
-
                 // Male has come or left
                 if (event == MALE || event == MALE_LEFT) 
                 {
-                    clocks[MALE] = generate_exponential(system.l1, rng);
+                    clocks[MALE] = system.sample_clock(MALE, now, rng);
                     clocks[FEMALE] -= passed_time;
                 }
 
                 // Female has come or left
                 if (event == FEMALE || event == FEMALE_LEFT) 
                 {
-                    clocks[FEMALE] = generate_exponential(system.l2, rng);
+                    clocks[FEMALE] = system.sample_clock(FEMALE, now, rng);
                     clocks[MALE] -= passed_time;
                 }
             }
@@ -150,26 +188,37 @@ private:
 
         std::array<size_t, 3> state;
         Timers timers;
+        Event male_event = MALE;      // What happens if male comes in current state: MALE or MALE_LEFT
+        Event female_event = FEMALE;  // FEMALE or FEMALE_LEFT
 
-        State(const System& system, RngStream& rng): state{0, 0, 0} 
+        State(const Basic_system& system, RngStream& rng): state{0, 0, 0} 
         {
-            timers.clocks[MALE] = generate_exponential(system.l1, rng);
-            timers.clocks[FEMALE] = generate_exponential(system.l2, rng);
+            timers.clocks[MALE] = system.sample_clock(MALE, 0, rng);
+            timers.clocks[FEMALE] = system.sample_clock(FEMALE, 0, rng);
             timers.clocks[SERVED] = 0;
+            system.admissible_events(state, male_event, female_event);
+        }
+
+        // Restores state saved in a checkpoint
+        State(const Basic_system& system, const std::array<size_t, 3>& state, const std::array<Real, 3>& clocks): state(state) 
+        {
+            timers.clocks = clocks;
+            system.admissible_events(state, male_event, female_event);
         }
 
-        std::pair<FP, Event> move_to_next_state(const System& system, RngStream& rng) 
+        // now is the current model time
+        std::pair<Real, Event> move_to_next_state(const Basic_system& system, RngStream& rng, FP now) 
         {
-            auto [passed_time, event] = timers.get_event(system, state);
+            auto [passed_time, event] = timers.get_event(male_event, female_event);
 
             // Change current state according to event
             if (event == SERVED) --state[SERVED];
             else if (event == MALE || event == FEMALE) ++state[event];
 
             // Conduction
-            state = system.conductor(state);
+            system.conduct(state, male_event, female_event);
 
-            timers.refresh(passed_time, event, rng, system, state);
+            timers.refresh(passed_time, now + passed_time, event, rng, system, state);
             return {passed_time, event};
         }
     };
@@ -182,12 +231,13 @@ public:
         size_t total_female = 0;
         size_t total_male_left = 0;
         size_t total_female_left = 0;
-        std::vector<std::array<size_t, 3>> passed_states{{0, 0, 0}};
+        State_histogram occupancy;  // Time spent in every state (male, female, served)
 
-        std::vector<FP> male_interarrival_times;
-        std::vector<FP> female_interarrival_times;
-        std::vector<FP> male_left_interarrival_times;
-        std::vector<FP> female_left_interarrival_times;
+        // Traces are stored with precision of clocks
+        std::vector<Real> male_interarrival_times;
+        std::vector<Real> female_interarrival_times;
+        std::vector<Real> male_left_interarrival_times;
+        std::vector<Real> female_left_interarrival_times;
 
         std::vector<FP> cycle_durations;
         std::vector<FP> cycle_cost_value;
@@ -196,6 +246,30 @@ public:
         std::vector<size_t> cycle_male_left;
         std::vector<size_t> cycle_female_left;
 
+        // Likelihood ratio derivatives of E[cycle cost] / E[arrivals per cycle] with respect to l1, l2 and mu.
+        // Collected only if all clocks are exponential with constant rates
+        Gradient_accumulator gradient;
+
+        // Streaming quantile estimates of the same values with bounded memory
+        Quantile_sketch cycle_cost_sketch;
+        Quantile_sketch cycle_duration_sketch;
+        Quantile_sketch male_interarrival_sketch;
+        Quantile_sketch female_interarrival_sketch;
+        Quantile_sketch male_left_interarrival_sketch;
+        Quantile_sketch female_left_interarrival_sketch;
+
+        // Binned samples of exponential MALE, FEMALE and SERVED clocks for goodness-of-fit tests,
+        // collected if System::set_goodness_of_fit_bins was called. Arrival clocks include customers who left
+        std::array<Exponential_summary, 3> clock_fit;
+
+        // Time-of-day statistics, collected if System::set_time_of_day_statistics was called.
+        // Bin i covers [i, i + 1) * period / bins of every period
+        FP time_of_day_period = 0;
+        std::vector<FP> time_of_day_time;          // Total time spent in the bin
+        std::vector<FP> time_of_day_queue_area;    // Integral of queue length (male + female) over the bin
+        std::vector<size_t> time_of_day_arrivals;
+        std::vector<size_t> time_of_day_left;
+
         void print() const
         {
             std::cout << "\n========= STATISTICS =========\n";
@@ -206,20 +280,92 @@ public:
             std::cout << "Female left:\t\t" << total_female_left << '\n';
             std::cout << "==============================\n";
         }
+
+        void print_gradient(FP confidence_level = 0.95) const
+        {
+            const char* names[3] = {"l1", "l2", "mu"};
+            std::cout << "\n========= GRADIENT =========\n";
+            if (gradient.n == 0)
+                std::cout << "Not collected\n";
+            for (size_t k = 0; gradient.n > 0 && k < 3; ++k)
+            {
+                auto [value, lower, upper] = gradient.derivative(k, confidence_level);
+                std::cout << "d/d " << names[k] << ":\t" << value << "\t[" << lower << ", " << upper << "]\n";
+            }
+            std::cout << "============================\n";
+        }
+
+        void print_quantiles() const
+        {
+            auto print_row = [](const char* name, const Quantile_sketch& sketch)
+            {
+                std::cout << name << '\t' << sketch.quantile(0.5) << '\t' << sketch.quantile(0.99) << '\t' << sketch.quantile(0.999) << '\n';
+            };
+
+            std::cout << "\n========= QUANTILES =========\n";
+            std::cout << "\t\t\tp50\tp99\tp99.9\n";
+            print_row("Cycle cost\t\t", cycle_cost_sketch);
+            print_row("Cycle duration\t\t", cycle_duration_sketch);
+            print_row("Male interarrival\t", male_interarrival_sketch);
+            print_row("Female interarrival\t", female_interarrival_sketch);
+            print_row("Male left interarrival\t", male_left_interarrival_sketch);
+            print_row("Female left interarrival", female_left_interarrival_sketch);
+            std::cout << "=============================\n";
+        }
+
+        // Stationary distribution of queue lengths estimated by the fraction of time spent in each state
+        void print_occupancy() const
+        {
+            const char* names[3] = {"Male queue", "Female queue", "Served"};
+            std::cout << "\n========= OCCUPANCY =========\n";
+            for (size_t dimension = 0; dimension < 3; ++dimension)
+            {
+                std::vector<FP> p = occupancy.marginal(dimension);
+                std::cout << names[dimension] << " (mean " << occupancy.mean(dimension) << "):\n";
+                for (size_t i = 0; i < p.size(); ++i)
+                    if (p[i] > 0)
+                        std::cout << "  " << i << (i + 1 == p.size() ? "+" : "") << '\t' << p[i] << '\n';
+            }
+            std::cout << "=============================\n";
+        }
+
+        void print_time_of_day() const
+        {
+            size_t bins = time_of_day_time.size();
+            std::cout << "\n======= TIME OF DAY =======\n";
+            std::cout << "Start\tQueue\tArrivals/time\tLeft fraction\n";
+            for (size_t i = 0; i < bins; ++i)
+            {
+                FP time = time_of_day_time[i];
+                size_t total = time_of_day_arrivals[i] + time_of_day_left[i];
+                std::cout << time_of_day_period * i / bins << '\t'
+                          << (time > 0 ? time_of_day_queue_area[i] / time : 0) << '\t'
+                          << (time > 0 ? total / time : 0) << "\t\t"
+                          << (total > 0 ? FP(time_of_day_left[i]) / total : 0) << '\n';
+            }
+            std::cout << "===========================\n";
+        }
     };
 
-    Statistics run(RngStream rng = RngStream()) 
+    // Full state of an unfinished (or finished) run. It can be saved to a binary file
+    // and resumed later with the same results as an uninterrupted run
+    struct Checkpoint
     {
+        unsigned collected = COLLECT_ALL;  // Statistics the run collects; resume must collect the same
+        std::array<size_t, 3> state{0, 0, 0};
+        std::array<Real, 3> clocks{0, 0, 0};
+        unsigned long rng_state[6];
+
         FP total_elapsed_time = 0;
-        State state(*this, rng);
-        Statistics obtained_stat;
-    
         FP cycle_start_time = 0;
         size_t cycle_male_count = 0;
         size_t cycle_female_count = 0;
         size_t cycle_male_left_count = 0;
         size_t cycle_female_left_count = 0;
 
+        size_t cycle_served_count = 0;
+        FP cycle_busy_time = 0;
+
         bool queue_was_empty = true;
         FP cycle_cost_value = 0;
 
@@ -227,76 +373,230 @@ public:
         FP last_female_arrival_time = 0;
         FP last_male_left_arrival_time = 0;
         FP last_female_left_arrival_time = 0;
+        FP service_start_time = 0;
 
-        while (total_elapsed_time < T) 
+        Statistics stat;
+
+        bool save(const std::string& path) const
         {
-            State previous_state = state;
-            auto [passed_time, event] = state.move_to_next_state(*this, rng);
-            total_elapsed_time += passed_time;
+            // Write to temporary file first so a crash during saving does not destroy the previous checkpoint
+            std::string tmp_path = path + ".tmp";
+            {
+                std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+                if (!out)
+                    return false;
 
-            cycle_cost_value += cost_function(previous_state.state, passed_time);
+                out.write(checkpoint_magic, sizeof(checkpoint_magic));
+                write_value(out, collected);
+                write_value(out, state);
+                write_value(out, clocks);
+                write_value(out, rng_state);
 
+                write_value(out, total_elapsed_time);
+                write_value(out, cycle_start_time);
+                write_value(out, cycle_male_count);
+                write_value(out, cycle_female_count);
+                write_value(out, cycle_male_left_count);
+                write_value(out, cycle_female_left_count);
+                write_value(out, cycle_served_count);
+                write_value(out, cycle_busy_time);
+                write_value(out, queue_was_empty);
+                write_value(out, cycle_cost_value);
+                write_value(out, last_male_arrival_time);
+                write_value(out, last_female_arrival_time);
+                write_value(out, last_male_left_arrival_time);
+                write_value(out, last_female_left_arrival_time);
+                write_value(out, service_start_time);
 
-            // We can reduce all these checks by storing all cycle data as vector of arrays or smth like that
-            // Obtain data for current cycle
-            if (event == MALE) 
-            {
-                ++cycle_male_count;
-                obtained_stat.male_interarrival_times.push_back(total_elapsed_time - last_male_arrival_time);
-                last_male_arrival_time = total_elapsed_time;
-            }
-            else if (event == FEMALE) 
-            {
-                ++cycle_female_count;
-                obtained_stat.female_interarrival_times.push_back(total_elapsed_time - last_female_arrival_time);
-                last_female_arrival_time = total_elapsed_time;
+                write_value(out, stat.downtime);
+                write_value(out, stat.total_male);
+                write_value(out, stat.total_female);
+                write_value(out, stat.total_male_left);
+                write_value(out, stat.total_female_left);
+                write_value(out, stat.gradient);
+                write_value(out, stat.occupancy.get_limits());
+                write_vector(out, stat.occupancy.get_weights());
+                write_vector(out, stat.male_interarrival_times);
+                write_vector(out, stat.female_interarrival_times);
+                write_vector(out, stat.male_left_interarrival_times);
+                write_vector(out, stat.female_left_interarrival_times);
+                write_vector(out, stat.cycle_durations);
+                write_vector(out, stat.cycle_cost_value);
+                write_vector(out, stat.cycle_male_arrivals);
+                write_vector(out, stat.cycle_female_arrivals);
+                write_vector(out, stat.cycle_male_left);
+                write_vector(out, stat.cycle_female_left);
+                write_value(out, stat.time_of_day_period);
+                write_vector(out, stat.time_of_day_time);
+                write_vector(out, stat.time_of_day_queue_area);
+                write_vector(out, stat.time_of_day_arrivals);
+                write_vector(out, stat.time_of_day_left);
+                stat.cycle_cost_sketch.write(out);
+                stat.cycle_duration_sketch.write(out);
+                stat.male_interarrival_sketch.write(out);
+                stat.female_interarrival_sketch.write(out);
+                stat.male_left_interarrival_sketch.write(out);
+                stat.female_left_interarrival_sketch.write(out);
+                for (const Exponential_summary& summary : stat.clock_fit)
+                    summary.write(out);
+
+                if (!out)
+                    return false;
             }
-            else if (event == MALE_LEFT) 
+            return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+        }
+
+        bool load(const std::string& path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            char magic[sizeof(checkpoint_magic)];
+            if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), checkpoint_magic))
             {
-                ++cycle_male_left_count;
-                obtained_stat.male_left_interarrival_times.push_back(total_elapsed_time - last_male_left_arrival_time);
-                last_male_left_arrival_time = total_elapsed_time;
+                std::cerr << "ERROR: " << path << " is not a simulation checkpoint.\n";
+                return false;
             }
-            else if (event == FEMALE_LEFT) 
+
+            read_value(in, collected);
+            read_value(in, state);
+            read_value(in, clocks);
+            read_value(in, rng_state);
+
+            read_value(in, total_elapsed_time);
+            read_value(in, cycle_start_time);
+            read_value(in, cycle_male_count);
+            read_value(in, cycle_female_count);
+            read_value(in, cycle_male_left_count);
+            read_value(in, cycle_female_left_count);
+            read_value(in, cycle_served_count);
+            read_value(in, cycle_busy_time);
+            read_value(in, queue_was_empty);
+            read_value(in, cycle_cost_value);
+            read_value(in, last_male_arrival_time);
+            read_value(in, last_female_arrival_time);
+            read_value(in, last_male_left_arrival_time);
+            read_value(in, last_female_left_arrival_time);
+            read_value(in, service_start_time);
+
+            read_value(in, stat.downtime);
+            read_value(in, stat.total_male);
+            read_value(in, stat.total_female);
+            read_value(in, stat.total_male_left);
+            read_value(in, stat.total_female_left);
+            read_value(in, stat.gradient);
+            std::array<size_t, 3> occupancy_limits;
+            read_value(in, occupancy_limits);
+            stat.occupancy = State_histogram(occupancy_limits[0], occupancy_limits[1], occupancy_limits[2]);
+            read_vector(in, stat.occupancy.get_weights());
+            read_vector(in, stat.male_interarrival_times);
+            read_vector(in, stat.female_interarrival_times);
+            read_vector(in, stat.male_left_interarrival_times);
+            read_vector(in, stat.female_left_interarrival_times);
+            read_vector(in, stat.cycle_durations);
+            read_vector(in, stat.cycle_cost_value);
+            read_vector(in, stat.cycle_male_arrivals);
+            read_vector(in, stat.cycle_female_arrivals);
+            read_vector(in, stat.cycle_male_left);
+            read_vector(in, stat.cycle_female_left);
+            read_value(in, stat.time_of_day_period);
+            read_vector(in, stat.time_of_day_time);
+            read_vector(in, stat.time_of_day_queue_area);
+            read_vector(in, stat.time_of_day_arrivals);
+            read_vector(in, stat.time_of_day_left);
+            stat.cycle_cost_sketch.read(in);
+            stat.cycle_duration_sketch.read(in);
+            stat.male_interarrival_sketch.read(in);
+            stat.female_interarrival_sketch.read(in);
+            stat.male_left_interarrival_sketch.read(in);
+            stat.female_left_interarrival_sketch.read(in);
+            for (Exponential_summary& summary : stat.clock_fit)
+                summary.read(in);
+
+            if (!in)
             {
-                ++cycle_female_left_count;
-                obtained_stat.female_left_interarrival_times.push_back(total_elapsed_time - last_female_left_arrival_time);
-                last_female_left_arrival_time = total_elapsed_time;
+                std::cerr << "ERROR: checkpoint " << path << " is truncated.\n";
+                return false;
             }
+            return true;
+        }
 
-            // Check for regenerative condition
-            if (is_regenerative_state(state.state)) 
-            {
-                obtained_stat.cycle_durations.push_back(total_elapsed_time - cycle_start_time);
-                obtained_stat.cycle_male_arrivals.push_back(cycle_male_count);
-                obtained_stat.cycle_female_arrivals.push_back(cycle_female_count);
-                obtained_stat.cycle_male_left.push_back(cycle_male_left_count);
-                obtained_stat.cycle_female_left.push_back(cycle_female_left_count);
-                obtained_stat.cycle_cost_value.push_back(cycle_cost_value);
+    private:
+        // Checkpoints of float and double clocks are not interchangeable
+        static constexpr char checkpoint_magic[8] = {'S', 'Y', 'S', 'C', 'K', 'P', sizeof(Real) == sizeof(FP) ? 'T' : 'F', '5'};
 
-                // Renew couners for new cycle
-                cycle_start_time = total_elapsed_time;
-                cycle_male_count = 0;
-                cycle_female_count = 0;
-                cycle_male_left_count = 0;
-                cycle_female_left_count = 0;
-                cycle_cost_value = 0;
-            }
+        template <typename T>
+        static void write_value(std::ofstream& out, const T& value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
 
-            // Obtain general data
-            if (queue_was_empty) obtained_stat.downtime += passed_time;    
-            queue_was_empty = !(state.state[MALE] || state.state[FEMALE]);
+        template <typename T>
+        static void read_value(std::ifstream& in, T& value)
+        {
+            in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        static void write_vector(std::ofstream& out, const std::vector<T>& v)
+        {
+            uint64_t size = v.size();
+            write_value(out, size);
+            out.write(reinterpret_cast<const char*>(v.data()), size * sizeof(T));
+        }
+
+        template <typename T>
+        static void read_vector(std::ifstream& in, std::vector<T>& v)
+        {
+            uint64_t size = 0;
+            read_value(in, size);
+            if (!in)
+                return;
+            v.resize(size);
+            in.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
         }
+    };
+
+    // Only statistics of the collected set are filled, e.g. run<COLLECT_ESTIMATOR>(rng) keeps cycles of the ratio estimator
+    template <unsigned collected = COLLECT_ALL>
+    Statistics run(RngStream rng = RngStream()) 
+    {
+        Checkpoint checkpoint = start<collected>(rng);
+        simulate<collected>(checkpoint, rng);
+        return std::move(checkpoint.stat);
+    }
 
-        obtained_stat.total_male = obtained_stat.male_interarrival_times.size();
-        obtained_stat.total_female = obtained_stat.female_interarrival_times.size();
-        obtained_stat.total_male_left = obtained_stat.male_left_interarrival_times.size();
-        obtained_stat.total_female_left = obtained_stat.female_left_interarrival_times.size();
+    // Creates checkpoint of a new run at time 0 that collects the given statistics
+    template <unsigned collected = COLLECT_ALL>
+    Checkpoint start(RngStream& rng) const
+    {
+        State state(*this, rng);
+        Checkpoint checkpoint;
+        checkpoint.collected = collected;
+        checkpoint.state = state.state;
+        checkpoint.clocks = state.timers.clocks;
+        rng.GetState(checkpoint.rng_state);
+        return checkpoint;
+    }
 
-        return obtained_stat;
+    // Continues the run stored in checkpoint up to time T. The checkpoint is updated in place, 
+    // so a finished run can be extended by increasing T and resuming again.
+    // If checkpoint_interval > 0, the checkpoint is saved to checkpoint_path every checkpoint_interval units of model time.
+    // The collected set must be the one the checkpoint was started with; otherwise the run is not continued
+    template <unsigned collected = COLLECT_ALL>
+    Statistics resume(Checkpoint& checkpoint, FP checkpoint_interval = 0, const std::string& checkpoint_path = "")
+    {
+        if (checkpoint.collected != collected)
+        {
+            std::cerr << "ERROR: checkpoint collects statistics " << checkpoint.collected << ", resume collects " << collected << ".\n";
+            return checkpoint.stat;
+        }
+        RngStream rng;
+        rng.SetSeed(checkpoint.rng_state);
+        simulate<collected>(checkpoint, rng, checkpoint_interval, checkpoint_path);
+        return checkpoint.stat;
     }
 
     // Runs n different experiments using multi-threading
+    template <unsigned collected = COLLECT_ALL>
     Vector_of_stats run(size_t n) 
     {
         Vector_of_stats stat_vector(n);
@@ -305,26 +605,195 @@ public:
         for (size_t i = 0; i < n; ++i) 
         {
             RngStream rng;
-            stat_vector[i] = run(rng);
+            stat_vector[i] = run<collected>(rng);
         }
 
         return stat_vector;
     }
 
+    // Runs n experiments using multi-threading while estimator thread consumes their cycles as they complete.
+    // Experiments end before time T if estimator reaches its target precision
+    template <unsigned collected = COLLECT_ALL>
+    Vector_of_stats run(size_t n, Live_estimator& estimator) 
+    {
+        Vector_of_stats stat_vector(n);
+        std::vector<RngStream> streams(n);
 
-    System(FP time = 100, FP l1 = 1, FP l2 = 1, FP mu = 1, Conductor conductor = default_conductor, 
+        estimator.start();
+
+        #pragma omp parallel for num_threads(estimator.num_channels())
+        for (size_t i = 0; i < n; ++i) 
+        {
+            Checkpoint checkpoint = start<collected>(streams[i]);
+            simulate<collected>(checkpoint, streams[i], 0, "", &estimator.channel(omp_get_thread_num()));
+            stat_vector[i] = std::move(checkpoint.stat);
+        }
+
+        estimator.finish();
+        return stat_vector;
+    }
+
+
+    Basic_system(FP time = 100, FP l1 = 1, FP l2 = 1, FP mu = 1, Conductor conductor = default_conductor, 
     std::function<FP(std::array<size_t, 3>, FP)> cost_function = default_cost_function): 
-            T(time), l1(l1), l2(l2), mu(mu), conductor(conductor), cost_function(cost_function) {}
+            T(time), l1(l1), l2(l2), mu(mu), conductor(conductor), cost_function(cost_function),
+            distributions{Distribution::exponential(l1), Distribution::exponential(l2), Distribution::exponential(mu)} {}
+
+    // Same model with clocks of another precision
+    template <typename Other>
+    explicit Basic_system(const Basic_system<Other>& other):
+            T(other.T), l1(other.l1), l2(other.l2), mu(other.mu), 
+            male_queue_limit(other.male_queue_limit), female_queue_limit(other.female_queue_limit),
+            occupancy_limits(other.occupancy_limits), sketch_compression(other.sketch_compression),
+            goodness_of_fit_bins(other.goodness_of_fit_bins), progress(other.progress), progress_period(other.progress_period),
+            progress_first_slot(other.progress_first_slot),
+            cost_function(other.cost_function), conductor(other.conductor),
+            distributions(other.distributions), arrival_rates(other.arrival_rates),
+            time_of_day_period(other.time_of_day_period), time_of_day_bins(other.time_of_day_bins),
+            served_limit(other.served_limit)
+    {
+        transitions.reserve(other.transitions.size());
+        for (const auto& t : other.transitions)
+            transitions.push_back({t.male, t.female, t.served, t.male_event, t.female_event});
+    }
+
+    // Runs n replications up to the last time of grid (sorted) and returns distribution of the state at every
+    // time of grid. States above limits are put into the last bins. Every thread fills its own histograms,
+    // they are merged after all replications are done
+    Transient_result run_transient(const std::vector<FP>& grid, size_t n, std::array<size_t, 3> limits)
+    {
+        Transient_result result{grid, std::vector<State_histogram>(grid.size(), State_histogram(limits[0], limits[1], limits[2]))};
+        if (grid.empty())
+            return result;
+
+        std::vector<std::vector<State_histogram>> thread_histograms(omp_get_max_threads(), result.histograms);
+
+        // Streams are created in blocks, so stream of every replication does not depend on scheduling
+        // and memory does not grow with n
+        const size_t block = 4096;
+        for (size_t first = 0; first < n; first += block)
+        {
+            std::vector<RngStream> streams(std::min(block, n - first));
+
+            #pragma omp parallel for schedule(dynamic, 16)
+            for (size_t i = 0; i < streams.size(); ++i)
+                simulate_transient(streams[i], grid, thread_histograms[omp_get_thread_num()]);
+        }
+
+        #pragma omp parallel for
+        for (size_t g = 0; g < grid.size(); ++g)
+            for (const auto& histograms : thread_histograms)
+                result.histograms[g].merge(histograms[g]);
+
+        return result;
+    }
+
+    void set_time(FP time)
+    {
+        this->T = time;
+    }
+
+    FP get_time() const
+    {
+        return T;
+    }
+
+    // Bounds of occupancy histogram; time in states above them is counted in the last bins
+    void set_occupancy_limits(size_t male_limit, size_t female_limit, size_t served_limit)
+    {
+        occupancy_limits = {male_limit, female_limit, served_limit};
+    }
+
+    // Accuracy of quantile sketches in Statistics; about compression / 2 centroids are kept per sketch
+    void set_sketch_compression(FP compression)
+    {
+        sketch_compression = compression;
+    }
 
+    // Number of bins of goodness-of-fit summaries of clocks in Statistics; 0 disables them
+    void set_goodness_of_fit_bins(size_t bins)
+    {
+        goodness_of_fit_bins = bins;
+    }
+
+    // Runs publish their progress into the slot of their thread every period seconds of wall time.
+    // The board must outlive the runs and have a slot for every thread; nullptr disables publishing
+    bool set_progress(Progress_board* board, FP period = 1)
+    {
+        progress = board && board->is_open() ? board : nullptr;
+        progress_period = period;
+        if (progress && progress->size() < size_t(omp_get_max_threads()))
+        {
+            std::cerr << "ERROR: progress board has " << progress->size() << " slots for " << omp_get_max_threads() << " threads.\n";
+            progress = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    // Thread t publishes into slot first_slot + t. Every process of run_multiprocess has its own thread 0,
+    // so each worker takes the slot of its index
+    void set_progress_first_slot(size_t first_slot)
+    {
+        progress_first_slot = first_slot;
+    }
+
+    // With finite limits the conductor is tabulated over all states, so it has to depend on the state only
     void set_queues_limits(size_t male_queue_limit, size_t female_queue_limit)
     {
         this->male_queue_limit = male_queue_limit;
         this->female_queue_limit = female_queue_limit;
+        build_transitions();
     }
 
     void set_conductor(Conductor new_conductor)
     {
         this->conductor = new_conductor;
+        build_transitions();
+    }
+
+    bool has_transition_table() const
+    {
+        return !transitions.empty();
+    }
+
+    // Replaces distribution of MALE, FEMALE or SERVED clock. Parameters l1, l2, mu become 1 / mean of new distribution
+    void set_distribution(Event clock, const Distribution& distribution)
+    {
+        distributions[clock] = distribution;
+        FP rate = 1 / distribution.mean();
+        if (clock == MALE) l1 = rate;
+        else if (clock == FEMALE) l2 = rate;
+        else mu = rate;
+    }
+
+    const Distribution& get_distribution(Event clock) const
+    {
+        return distributions[clock];
+    }
+
+    // Makes MALE or FEMALE arrivals nonhomogeneous Poisson with periodic rate. l1 or l2 becomes mean rate.
+    // Note that cycles of such a system are not identically distributed, so use time-of-day statistics instead
+    void set_arrival_rate(Event clock, const Rate_function& rate)
+    {
+        arrival_rates[clock] = rate;
+        if (clock == MALE) l1 = rate.mean();
+        else l2 = rate.mean();
+    }
+
+    // Collects queue length, arrivals and rejections in `bins` bins of a period (e.g. 24 hours of a day)
+    void set_time_of_day_statistics(FP period, size_t bins)
+    {
+        time_of_day_period = period;
+        time_of_day_bins = bins;
+    }
+
+    // Time until the next event of clock that is set at time now
+    Real sample_clock(Event clock, FP now, RngStream& rng) const
+    {
+        if (clock != SERVED && !arrival_rates[clock].empty())
+            return Real(arrival_rates[clock].next_arrival(now, rng) - now);
+        return distributions[clock].template sample<Real>(rng);
     }
 
     void set_cost_function(std::function<FP(std::array<size_t, 3>, FP)> new_cost_function)
@@ -355,40 +824,484 @@ public:
     }
 
 private:
-    bool is_regenerative_state(const std::array<size_t, 3>& state) 
+    void admissible_events(const std::array<size_t, 3>& state, Event& male_event, Event& female_event) const
     {
-        return (state[0] + state[1] + state[2]) == 0;
+        male_event = state[MALE] < male_queue_limit ? MALE : MALE_LEFT;
+        female_event = state[FEMALE] < female_queue_limit ? FEMALE : FEMALE_LEFT;
     }
 
-};
+    // Applies conductor to the state after an event and updates what happens on the next arrivals
+    void conduct(std::array<size_t, 3>& state, Event& male_event, Event& female_event) const
+    {
+        if (!transitions.empty())
+        {
+            const Transition& t = transitions[(state[MALE] * (female_queue_limit + 1) + state[FEMALE]) * (served_limit + 1) + state[SERVED]];
+            state = {t.male, t.female, t.served};
+            male_event = Event(t.male_event);
+            female_event = Event(t.female_event);
+            return;
+        }
 
+        state = conductor(state);
+        admissible_events(state, male_event, female_event);
+    }
 
-void validate_simulation(System& system, size_t num_experiments) 
-{
-    std::vector<FP> male_interarrival_times;
-    for (size_t i = 0; i < num_experiments; ++i) {
-        RngStream rng;
-        System::Statistics stats = system.run(rng);
-        male_interarrival_times.insert(male_interarrival_times.end(), 
-                                       stats.male_interarrival_times.begin(), 
-                                       stats.male_interarrival_times.end());
+    // Tabulates conductor for male <= male_queue_limit, female <= female_queue_limit and served <= served_limit,
+    // where served_limit is the largest number of served people the conductor can produce from such states.
+    // The table is not built if it would be too large or the conductor leaves these bounds
+    void build_transitions()
+    {
+        transitions.clear();
+        if (male_queue_limit >= UINT32_MAX || female_queue_limit >= UINT32_MAX)
+            return;
+
+        size_t queue_states = (male_queue_limit + 1) * (female_queue_limit + 1);
+        if (queue_states > max_transition_table_size)
+            return;
+
+        // Find served_limit as a fixed point: served counts that can appear after conduction
+        served_limit = 0;
+        for (bool grown = true; grown; )
+        {
+            grown = false;
+            if (queue_states * (served_limit + 1) > max_transition_table_size)
+                return;
+
+            for (size_t male = 0; male <= male_queue_limit; ++male)
+                for (size_t female = 0; female <= female_queue_limit; ++female)
+                    for (size_t served = 0; served <= served_limit; ++served)
+                    {
+                        std::array<size_t, 3> next = conductor({male, female, served});
+                        if (next[MALE] > male_queue_limit || next[FEMALE] > female_queue_limit)
+                            return;
+                        if (next[SERVED] > served_limit)
+                        {
+                            served_limit = next[SERVED];
+                            grown = true;
+                        }
+                    }
+        }
+
+        std::vector<Transition> table(queue_states * (served_limit + 1));
+        for (size_t male = 0; male <= male_queue_limit; ++male)
+            for (size_t female = 0; female <= female_queue_limit; ++female)
+                for (size_t served = 0; served <= served_limit; ++served)
+                {
+                    std::array<size_t, 3> next = conductor({male, female, served});
+                    Event male_event, female_event;
+                    admissible_events(next, male_event, female_event);
+
+                    table[(male * (female_queue_limit + 1) + female) * (served_limit + 1) + served] = 
+                        {uint32_t(next[MALE]), uint32_t(next[FEMALE]), uint32_t(next[SERVED]), uint8_t(male_event), uint8_t(female_event)};
+                }
+        transitions = std::move(table);
     }
 
-    if (male_interarrival_times.empty()) {
-        std::cout << "No valid male interarrival times were collected.\n";
-        return;
+    void simulate_transient(RngStream& rng, const std::vector<FP>& grid, std::vector<State_histogram>& histograms)
+    {
+        State state(*this, rng);
+        FP now = 0;
+        size_t g = 0;
+
+        while (g < grid.size())
+        {
+            std::array<size_t, 3> previous_state = state.state;
+            Real passed_time = state.move_to_next_state(*this, rng, now).first;
+            now += passed_time;
+
+            // Previous state was held on [now - passed_time, now)
+            while (g < grid.size() && grid[g] < now)
+                histograms[g++].add(previous_state);
+        }
     }
 
-    FP l1 = system.get_distribution_params()[0];
-    FP mean_interarrival_time = mean(male_interarrival_times);
-    FP expected_mean = 1 / l1; // ожидаемое значение для экспоненциального распределения с параметром lambda = l1
+    // If channel is given, every completed cycle is pushed into it and the run stops when estimator asks for it
+    template <unsigned collected = COLLECT_ALL>
+    void simulate(Checkpoint& checkpoint, RngStream& rng, FP checkpoint_interval = 0, const std::string& checkpoint_path = "",
+                  Live_estimator::Channel* channel = nullptr)
+    {
+        FP total_elapsed_time = checkpoint.total_elapsed_time;
+        State state(*this, checkpoint.state, checkpoint.clocks);
+        Statistics& obtained_stat = checkpoint.stat;
+    
+        FP cycle_start_time = checkpoint.cycle_start_time;
+        size_t cycle_male_count = checkpoint.cycle_male_count;
+        size_t cycle_female_count = checkpoint.cycle_female_count;
+        size_t cycle_male_left_count = checkpoint.cycle_male_left_count;
+        size_t cycle_female_left_count = checkpoint.cycle_female_left_count;
+
+        size_t cycle_served_count = checkpoint.cycle_served_count;
+        FP cycle_busy_time = checkpoint.cycle_busy_time;
+
+        bool queue_was_empty = checkpoint.queue_was_empty;
+        FP cycle_cost_value = checkpoint.cycle_cost_value;
+
+        FP last_male_arrival_time = checkpoint.last_male_arrival_time;
+        FP last_female_arrival_time = checkpoint.last_female_arrival_time;
+        FP last_male_left_arrival_time = checkpoint.last_male_left_arrival_time;
+        FP last_female_left_arrival_time = checkpoint.last_female_left_arrival_time;
+        FP service_start_time = checkpoint.service_start_time;
+
+        auto store_checkpoint = [&]()
+        {
+            checkpoint.state = state.state;
+            checkpoint.clocks = state.timers.clocks;
+            rng.GetState(checkpoint.rng_state);
+
+            checkpoint.total_elapsed_time = total_elapsed_time;
+            checkpoint.cycle_start_time = cycle_start_time;
+            checkpoint.cycle_male_count = cycle_male_count;
+            checkpoint.cycle_female_count = cycle_female_count;
+            checkpoint.cycle_male_left_count = cycle_male_left_count;
+            checkpoint.cycle_female_left_count = cycle_female_left_count;
+            checkpoint.cycle_served_count = cycle_served_count;
+            checkpoint.cycle_busy_time = cycle_busy_time;
+            checkpoint.queue_was_empty = queue_was_empty;
+            checkpoint.cycle_cost_value = cycle_cost_value;
+            checkpoint.last_male_arrival_time = last_male_arrival_time;
+            checkpoint.last_female_arrival_time = last_female_arrival_time;
+            checkpoint.last_male_left_arrival_time = last_male_left_arrival_time;
+            checkpoint.last_female_left_arrival_time = last_female_left_arrival_time;
+            checkpoint.service_start_time = service_start_time;
+        };
+
+        constexpr bool collect_cycles = collected & COLLECT_CYCLES;
+        constexpr bool collect_cycle_details = collected & COLLECT_CYCLE_DETAILS;
+        constexpr bool collect_traces = collected & COLLECT_TRACES;
+        constexpr bool collect_sketches = collected & COLLECT_SKETCHES;
+        constexpr bool collect_occupancy = collected & COLLECT_OCCUPANCY;
+        constexpr bool interarrivals = collected & (COLLECT_TRACES | COLLECT_SKETCHES | COLLECT_CLOCK_FIT);
+
+        // Resumed runs keep limits of their checkpoint
+        if (collect_occupancy && obtained_stat.occupancy.total() == 0)
+            obtained_stat.occupancy = State_histogram(occupancy_limits[0], occupancy_limits[1], occupancy_limits[2]);
+
+        if (collect_sketches && obtained_stat.cycle_cost_sketch.count() == 0 && obtained_stat.male_interarrival_sketch.count() == 0)
+        {
+            obtained_stat.cycle_cost_sketch = Quantile_sketch(sketch_compression);
+            obtained_stat.cycle_duration_sketch = Quantile_sketch(sketch_compression);
+            obtained_stat.male_interarrival_sketch = Quantile_sketch(sketch_compression);
+            obtained_stat.female_interarrival_sketch = Quantile_sketch(sketch_compression);
+            obtained_stat.male_left_interarrival_sketch = Quantile_sketch(sketch_compression);
+            obtained_stat.female_left_interarrival_sketch = Quantile_sketch(sketch_compression);
+        }
+
+        bool time_of_day = (collected & COLLECT_TIME_OF_DAY) && time_of_day_bins > 0 && time_of_day_period > 0;
+        if (time_of_day && obtained_stat.time_of_day_time.empty())
+        {
+            obtained_stat.time_of_day_period = time_of_day_period;
+            obtained_stat.time_of_day_time.assign(time_of_day_bins, 0);
+            obtained_stat.time_of_day_queue_area.assign(time_of_day_bins, 0);
+            obtained_stat.time_of_day_arrivals.assign(time_of_day_bins, 0);
+            obtained_stat.time_of_day_left.assign(time_of_day_bins, 0);
+        }
+        FP bin_width = time_of_day ? time_of_day_period / time_of_day_bins : 0;
+
+        // Only clocks that are exponential with constant rate are tested
+        std::array<bool, 3> fit;
+        for (Event clock : {MALE, FEMALE, SERVED})
+        {
+            fit[clock] = (collected & COLLECT_CLOCK_FIT) && goodness_of_fit_bins > 0 && distributions[clock].is_memoryless() && (clock == SERVED || arrival_rates[clock].empty());
+            if (fit[clock] && obtained_stat.clock_fit[clock].empty())
+                obtained_stat.clock_fit[clock] = Exponential_summary(1 / distributions[clock].mean(), goodness_of_fit_bins);
+        }
+
+        // Score of exponential clock with rate theta over a cycle of length t with N events is N / theta - t;
+        // service clock runs only while someone is served
+        bool gradient = (collected & COLLECT_GRADIENT) && arrival_rates[MALE].empty() && arrival_rates[FEMALE].empty() &&
+                        distributions[MALE].is_memoryless() && distributions[FEMALE].is_memoryless() && distributions[SERVED].is_memoryless();
+
+        bool checkpointing = checkpoint_interval > 0 && !checkpoint_path.empty();
+        FP next_checkpoint_time = total_elapsed_time + checkpoint_interval;
+
+        // Clock is read once in 4096 events, so publishing costs nothing when the period has not passed
+        // Threads beyond the slots of the board (e.g. of a larger num_threads clause) do not publish, as slots have one writer
+        size_t slot = progress_first_slot + omp_get_thread_num();
+        Progress_slot* progress_slot = progress && slot < progress->size() ? &progress->slot(slot) : nullptr;
+        Progress_data progress_data = progress_slot ? progress_slot->data : Progress_data();  // Only this thread writes the slot
+        auto last_publish_time = std::chrono::steady_clock::now();
+        uint64_t last_publish_events = progress_data.events;
+        auto publish_progress = [&](std::chrono::steady_clock::time_point now)
+        {
+            FP seconds = std::chrono::duration<FP>(now - last_publish_time).count();
+            progress_data.simulated_time = total_elapsed_time;
+            progress_data.end_time = T;
+            progress_data.events_per_second = seconds > 0 ? (progress_data.events - last_publish_events) / seconds : 0;
+            progress_data.updated = seconds_since_epoch();
+            progress_slot->publish(progress_data);
+            last_publish_time = now;
+            last_publish_events = progress_data.events;
+        };
+        if (progress_slot)
+            publish_progress(last_publish_time);
+
+        while (total_elapsed_time < T) 
+        {
+            State previous_state = state;
+            auto [passed_time, event] = state.move_to_next_state(*this, rng, total_elapsed_time);
+            total_elapsed_time += passed_time;
+
+            cycle_cost_value += cost_function(previous_state.state, passed_time);
+            if constexpr (collect_occupancy)
+                obtained_stat.occupancy.add(previous_state.state, passed_time);
+            if constexpr ((collected & COLLECT_GRADIENT) != 0)
+            {
+                if (previous_state.state[SERVED] != 0) cycle_busy_time += passed_time;
+                if (event == SERVED) ++cycle_served_count;
+            }
+
+            // Samples of the clocks that fired: arrival clocks restart at every arrival of their sex, 
+            // service clock at start of every service
+            if constexpr ((collected & COLLECT_CLOCK_FIT) != 0)
+            {
+                if (fit[MALE] && (event == MALE || event == MALE_LEFT))
+                    obtained_stat.clock_fit[MALE].add(total_elapsed_time - std::max(last_male_arrival_time, last_male_left_arrival_time));
+                else if (fit[FEMALE] && (event == FEMALE || event == FEMALE_LEFT))
+                    obtained_stat.clock_fit[FEMALE].add(total_elapsed_time - std::max(last_female_arrival_time, last_female_left_arrival_time));
+                else if (fit[SERVED] && event == SERVED)
+                    obtained_stat.clock_fit[SERVED].add(total_elapsed_time - service_start_time);
+                if (state.timers.clocks[SERVED] != 0 && (previous_state.timers.clocks[SERVED] == 0 || event == SERVED))
+                    service_start_time = total_elapsed_time;
+            }
 
-    std::cout << "Mean interarrival time: " << mean_interarrival_time << "\n";
-    std::cout << "Expected mean: " << expected_mean << "\n";
-    std::cout << "Difference: " << std::abs(mean_interarrival_time - expected_mean) << "\n";
 
-    auto [ci_lower, ci_upper] = confidence_interval(male_interarrival_times);
-    std::cout << "95% Confidence Interval for mean interarrival time: [" << ci_lower << ", " << ci_upper << "]" << std::endl;
+            // We can reduce all these checks by storing all cycle data as vector of arrays or smth like that
+            // Obtain data for current cycle
+            if (event == MALE) 
+            {
+                ++cycle_male_count;
+                ++obtained_stat.total_male;
+                if constexpr (collect_traces)
+                    obtained_stat.male_interarrival_times.push_back(total_elapsed_time - last_male_arrival_time);
+                if constexpr (collect_sketches)
+                    obtained_stat.male_interarrival_sketch.add(total_elapsed_time - last_male_arrival_time);
+                if constexpr (interarrivals)
+                    last_male_arrival_time = total_elapsed_time;
+            }
+            else if (event == FEMALE) 
+            {
+                ++cycle_female_count;
+                ++obtained_stat.total_female;
+                if constexpr (collect_traces)
+                    obtained_stat.female_interarrival_times.push_back(total_elapsed_time - last_female_arrival_time);
+                if constexpr (collect_sketches)
+                    obtained_stat.female_interarrival_sketch.add(total_elapsed_time - last_female_arrival_time);
+                if constexpr (interarrivals)
+                    last_female_arrival_time = total_elapsed_time;
+            }
+            else if (event == MALE_LEFT) 
+            {
+                ++cycle_male_left_count;
+                ++obtained_stat.total_male_left;
+                if constexpr (collect_traces)
+                    obtained_stat.male_left_interarrival_times.push_back(total_elapsed_time - last_male_left_arrival_time);
+                if constexpr (collect_sketches)
+                    obtained_stat.male_left_interarrival_sketch.add(total_elapsed_time - last_male_left_arrival_time);
+                if constexpr (interarrivals)
+                    last_male_left_arrival_time = total_elapsed_time;
+            }
+            else if (event == FEMALE_LEFT) 
+            {
+                ++cycle_female_left_count;
+                ++obtained_stat.total_female_left;
+                if constexpr (collect_traces)
+                    obtained_stat.female_left_interarrival_times.push_back(total_elapsed_time - last_female_left_arrival_time);
+                if constexpr (collect_sketches)
+                    obtained_stat.female_left_interarrival_sketch.add(total_elapsed_time - last_female_left_arrival_time);
+                if constexpr (interarrivals)
+                    last_female_left_arrival_time = total_elapsed_time;
+            }
+
+            // Check for regenerative condition
+            if (is_regenerative_state(previous_state.state, state.state, event)) 
+            {
+                if constexpr (collect_cycles)
+                {
+                    obtained_stat.cycle_male_arrivals.push_back(cycle_male_count);
+                    obtained_stat.cycle_female_arrivals.push_back(cycle_female_count);
+                    obtained_stat.cycle_cost_value.push_back(cycle_cost_value);
+                }
+                if constexpr (collect_cycle_details)
+                {
+                    obtained_stat.cycle_durations.push_back(total_elapsed_time - cycle_start_time);
+                    obtained_stat.cycle_male_left.push_back(cycle_male_left_count);
+                    obtained_stat.cycle_female_left.push_back(cycle_female_left_count);
+                }
+                if constexpr (collect_sketches)
+                {
+                    obtained_stat.cycle_cost_sketch.add(cycle_cost_value);
+                    obtained_stat.cycle_duration_sketch.add(total_elapsed_time - cycle_start_time);
+                }
+
+                if (channel)
+                    channel->push({cycle_cost_value, FP(cycle_male_count + cycle_female_count), total_elapsed_time - cycle_start_time});
+
+                if (progress_slot)
+                    progress_data.cycles.add(cycle_cost_value, FP(cycle_male_count + cycle_female_count));
+
+                if (gradient)
+                {
+                    FP duration = total_elapsed_time - cycle_start_time;
+                    obtained_stat.gradient.add(cycle_cost_value, FP(cycle_male_count + cycle_female_count), {
+                        (cycle_male_count + cycle_male_left_count) / l1 - duration,
+                        (cycle_female_count + cycle_female_left_count) / l2 - duration,
+                        cycle_served_count / mu - cycle_busy_time
+                    });
+                }
+
+                // Renew couners for new cycle
+                cycle_start_time = total_elapsed_time;
+                cycle_male_count = 0;
+                cycle_female_count = 0;
+                cycle_male_left_count = 0;
+                cycle_female_left_count = 0;
+                cycle_cost_value = 0;
+                cycle_served_count = 0;
+                cycle_busy_time = 0;
+            }
+
+            if (time_of_day)
+            {
+                // Split holding time of previous state between bins it covers
+                FP queue_length = FP(previous_state.state[MALE] + previous_state.state[FEMALE]);
+                FP t = total_elapsed_time - passed_time;
+                while (t < total_elapsed_time)
+                {
+                    FP period_start = std::floor(t / time_of_day_period) * time_of_day_period;
+                    size_t bin = std::min(size_t((t - period_start) / bin_width), time_of_day_bins - 1);
+                    auto bin_end = [&](size_t b)
+                    {
+                        return b + 1 == time_of_day_bins ? period_start + time_of_day_period : period_start + (b + 1) * bin_width;
+                    };
+
+                    // Ends of bins are absolute times and t moves to them, so t advances even if
+                    // bin_width is inexact and the rest of the bin is below half an ulp of t
+                    FP end = bin_end(bin);
+                    while (end <= t && bin + 1 < time_of_day_bins)
+                        end = bin_end(++bin);
+                    if (end <= t || end > total_elapsed_time)
+                        end = total_elapsed_time;
+
+                    FP step = end - t;
+                    obtained_stat.time_of_day_time[bin] += step;
+                    obtained_stat.time_of_day_queue_area[bin] += queue_length * step;
+                    t = end;
+                }
+
+                size_t bin = std::min(size_t(std::fmod(total_elapsed_time, time_of_day_period) / bin_width), time_of_day_bins - 1);
+                if (event == MALE || event == FEMALE) ++obtained_stat.time_of_day_arrivals[bin];
+                else if (event == MALE_LEFT || event == FEMALE_LEFT) ++obtained_stat.time_of_day_left[bin];
+            }
+
+            // Obtain general data
+            if (queue_was_empty) obtained_stat.downtime += passed_time;    
+            queue_was_empty = !(state.state[MALE] || state.state[FEMALE]);
+
+            if (progress_slot && (++progress_data.events & 4095) == 0)
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (std::chrono::duration<FP>(now - last_publish_time).count() >= progress_period)
+                    publish_progress(now);
+            }
+
+            if (channel && channel->stop_requested() && total_elapsed_time == cycle_start_time)
+                break;
+
+            if (checkpointing && total_elapsed_time >= next_checkpoint_time)
+            {
+                store_checkpoint();
+                if (!checkpoint.save(checkpoint_path))
+                    std::cerr << "ERROR: failed to save checkpoint to " << checkpoint_path << '\n';
+                next_checkpoint_time = total_elapsed_time + checkpoint_interval;
+            }
+        }
+
+        if (progress_slot)
+        {
+            ++progress_data.runs;
+            publish_progress(std::chrono::steady_clock::now());
+        }
+
+        store_checkpoint();
+        if (checkpointing && !checkpoint.save(checkpoint_path))
+            std::cerr << "ERROR: failed to save checkpoint to " << checkpoint_path << '\n';
+    }
+
+private:
+    // Empty system is a regeneration point when both arrival clocks are memoryless (service clock is stopped then).
+    // If one arrival clock is not memoryless, regeneration happens when its customer comes into the empty system:
+    // its clock is fresh, service clock has just been set and the other arrival clock is memoryless.
+    // If both arrival clocks are not memoryless there are no regeneration points and no cycles are recorded
+    bool is_regenerative_state(const std::array<size_t, 3>& previous_state, const std::array<size_t, 3>& state, Event event) const
+    {
+        bool male_memoryless = distributions[MALE].is_memoryless();
+        bool female_memoryless = distributions[FEMALE].is_memoryless();
+
+        if (male_memoryless && female_memoryless)
+            return (state[0] + state[1] + state[2]) == 0;
+
+        if (male_memoryless == female_memoryless || (previous_state[0] + previous_state[1] + previous_state[2]) != 0)
+            return false;
+
+        if (!male_memoryless)
+            return event == MALE || event == MALE_LEFT;
+        return event == FEMALE || event == FEMALE_LEFT;
+    }
+
+};
+
+using System = Basic_system<>;
+
+
+// Runs replications in parallel and tests every exponential clock with KS, Anderson-Darling and chi-square tests.
+// Samples are only binned, so the total number of samples is not limited by memory.
+// Returns false if some test rejects at the given significance
+bool validate_simulation(const System& system, size_t num_experiments, FP significance = 0.01, size_t bins = 1 << 18)
+{
+    System validated = system;
+    validated.set_goodness_of_fit_bins(bins);
+
+    std::vector<RngStream> streams(num_experiments);
+    std::array<Exponential_summary, 3> summaries;
+
+    #pragma omp parallel
+    {
+        std::array<Exponential_summary, 3> local;
+
+        // Only clock fits are collected, and runs of a thread add to the same summaries,
+        // so the bins are not allocated and merged again for every run
+        #pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < num_experiments; ++i)
+        {
+            System::Checkpoint checkpoint = validated.start<COLLECT_CLOCK_FIT>(streams[i]);
+            checkpoint.stat.clock_fit = std::move(local);
+            validated.simulate<COLLECT_CLOCK_FIT>(checkpoint, streams[i]);
+            local = std::move(checkpoint.stat.clock_fit);
+        }
+
+        #pragma omp critical
+        for (size_t clock = 0; clock < 3; ++clock)
+            if (!local[clock].empty())
+                summaries[clock].merge(local[clock]);
+    }
+
+    bool passed = true;
+    const std::array<std::string, 3> names{"Male arrivals", "Female arrivals", "Service"};
+    std::cout << "\n======= VALIDATION =======\n";
+    for (size_t clock = 0; clock < 3; ++clock)
+    {
+        if (summaries[clock].count() < 2)
+        {
+            std::cout << names[clock] << ": not tested\n";
+            continue;
+        }
+        Fit_report report = goodness_of_fit(summaries[clock]);
+        report.print(names[clock]);
+        passed = passed && report.passed(significance);
+    }
+    std::cout << (passed ? "PASSED" : "FAILED") << " at significance " << significance << '\n';
+    std::cout << "==========================\n";
+    return passed;
 }
 
 #endif // __SYSTEM_H__
@@ -1,5 +1,5 @@
 cd ./src
 g++ main.cpp RngStream.cpp -I./../include/ -std=c++17 -fopenmp -o out.exe
-./out.exe
+./out.exe "$@"
 rm ./out.exe
 cd ..
\ No newline at end of file
@@ -245,6 +245,59 @@ int CheckSeed (const unsigned long seed[6])
     return 0;
 }
 
+
+//-------------------------------------------------------------------------
+// Powers of two of a jump matrix of both components: P1[b] = A1^(2^b)
+// and P2[b] = A2^(2^b) Mod m1, m2. Built once on first use.
+//
+struct JumpTable
+{
+    double P1[64][3][3], P2[64][3][3];
+
+    JumpTable (const double A1[3][3], const double A2[3][3])
+    {
+        MatTwoPowModM (A1, P1[0], m1, 0);
+        MatTwoPowModM (A2, P2[0], m2, 0);
+        for (int b = 1; b < 64; ++b) {
+            MatMatModM (P1[b - 1], P1[b - 1], P1[b], m1);
+            MatMatModM (P2[b - 1], P2[b - 1], P2[b], m2);
+        }
+    }
+};
+
+const JumpTable & StepJumps ()
+{
+    static const JumpTable table (A1p0, A2p0);
+    return table;
+}
+
+const JumpTable & SubstreamJumps ()
+{
+    static const JumpTable table (A1p76, A2p76);
+    return table;
+}
+
+const JumpTable & StreamJumps ()
+{
+    static const JumpTable table (A1p127, A2p127);
+    return table;
+}
+
+
+//-------------------------------------------------------------------------
+// Advance state s by n jumps of the table, one matrix-vector product
+// per nonzero bit of n.
+//
+void ApplyJumps (const JumpTable & table, unsigned long long n, double s[6])
+{
+    for (int b = 0; n > 0; ++b, n >>= 1) {
+        if (n & 1) {
+            MatVecModM (table.P1[b], s, s, m1);
+            MatVecModM (table.P2[b], &s[3], &s[3], m2);
+        }
+    }
+}
+
 } // end of anonymous namespace
 
 
@@ -309,6 +362,16 @@ double RngStream::nextSeed[6] =
 };
 
 
+//-------------------------------------------------------------------------
+// The seed of stream 0 for SetPosition; the package seed as it was
+// before any RngStream was declared.
+//
+double RngStream::packageSeed[6] =
+{
+   12345.0, 12345.0, 12345.0, 12345.0, 12345.0, 12345.0
+};
+
+
 //-------------------------------------------------------------------------
 // constructor
 //
@@ -371,7 +434,7 @@ bool RngStream::SetPackageSeed (const unsigned long seed[6])
    if (CheckSeed (seed))
       return false;                   // FAILURE     
    for (int i = 0; i < 6; ++i)
-      nextSeed[i] = seed[i];
+      nextSeed[i] = packageSeed[i] = seed[i];
    return true;                       // SUCCESS
 }
 
@@ -387,6 +450,38 @@ bool RngStream::SetSeed (const unsigned long seed[6])
 }
 
 
+//-------------------------------------------------------------------------
+// Go to offset k of substream j of stream i, where stream i is the i-th
+// stream declared after the last SetPackageSeed. Needs at most 64 matrix-
+// vector products per argument, whatever the distance.
+//
+void RngStream::SetPosition (unsigned long long i, unsigned long long j,
+                             unsigned long long k)
+{
+   for (int n = 0; n < 6; ++n)
+      Ig[n] = packageSeed[n];
+   ApplyJumps (StreamJumps (), i, Ig);
+   for (int n = 0; n < 6; ++n)
+      Bg[n] = Ig[n];
+   ApplyJumps (SubstreamJumps (), j, Bg);
+   for (int n = 0; n < 6; ++n)
+      Cg[n] = Bg[n];
+   ApplyJumps (StepJumps (), k, Cg);
+}
+
+
+//-------------------------------------------------------------------------
+// Go to the start of the n-th substream after the current one;
+// AdvanceSubstream (1) is the same as ResetNextSubstream ().
+//
+void RngStream::AdvanceSubstream (unsigned long long n)
+{
+   ApplyJumps (SubstreamJumps (), n, Bg);
+   for (int i = 0; i < 6; ++i)
+       Cg[i] = Bg[i];
+}
+
+
 //-------------------------------------------------------------------------
 // if e > 0, let n = 2^e + c;
 // if e < 0, let n = -2^(-e) + c;
@@ -397,6 +492,16 @@ void RngStream::AdvanceState (long e, long c)
 {
     double B1[3][3], C1[3][3], B2[3][3], C2[3][3];
 
+    // Forward jumps use the cached powers of two
+    if (e >= 0 && e < 64 && c >= 0) {
+        if (e > 0) {
+            MatVecModM (StepJumps ().P1[e], Cg, Cg, m1);
+            MatVecModM (StepJumps ().P2[e], &Cg[3], &Cg[3], m2);
+        }
+        ApplyJumps (StepJumps (), static_cast<unsigned long long> (c), Cg);
+        return;
+    }
+
     if (e > 0) {
         MatTwoPowModM (A1p0, B1, m1, e);
         MatTwoPowModM (A2p0, B2, m2, e);
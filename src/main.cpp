@@ -1,7 +1,13 @@
 #include <vector>
 #include <iostream>
 #include <omp.h>
+#include <fstream>
+#include <cstdio>
 #include "./../include/system.h"
+#include "./../include/batch.h"
+#include "./../include/lockstep.h"
+#include "./../include/multiserver.h"
+#include "./../include/rng_tests.h"
 
 template <typename Container>
 void print(Container cont) 
@@ -24,7 +30,121 @@ void test_system()
     stat.print();
 }
 
-void test_distribution() 
+void test_time_of_day()
+{
+    // 24 hours do not split into 7 bins exactly in floating point
+    System system(1000, 1, 1, 3.5);
+    system.set_time_of_day_statistics(24, 7);
+    System::Statistics stat = system.run();
+
+    FP total = 0;
+    for (FP time : stat.time_of_day_time)
+        total += time;
+    std::cout << "Time in 7 bins of 24 hours: " << total << (total >= 1000 ? " OK\n" : " FAILED\n");
+    stat.print_time_of_day();
+}
+
+void test_resume()
+{
+    System system(1000, 1, 1, 3.5);
+    RngStream rng;
+    RngStream rng_copy = rng;
+    System::Statistics uninterrupted = system.run(rng);
+
+    // Run is stopped at half time with values still in the sketch buffers
+    system.set_time(500);
+    System::Checkpoint checkpoint = system.start(rng_copy);
+    system.resume(checkpoint);
+    System::Checkpoint loaded;
+    if (!checkpoint.save("test_resume.ckpt") || !loaded.load("test_resume.ckpt"))
+        return;
+    system.set_time(1000);
+    System::Statistics resumed = system.resume(loaded);
+    std::remove("test_resume.ckpt");
+
+    bool same = uninterrupted.cycle_cost_value == resumed.cycle_cost_value;
+    for (FP q : {0.5, 0.99, 0.999})
+    {
+        same = same && uninterrupted.cycle_cost_sketch.quantile(q) == resumed.cycle_cost_sketch.quantile(q);
+        same = same && uninterrupted.cycle_duration_sketch.quantile(q) == resumed.cycle_duration_sketch.quantile(q);
+        same = same && uninterrupted.male_interarrival_sketch.quantile(q) == resumed.male_interarrival_sketch.quantile(q);
+    }
+    std::cout << "p99 of cycle cost: uninterrupted " << uninterrupted.cycle_cost_sketch.quantile(0.99)
+              << ", resumed " << resumed.cycle_cost_sketch.quantile(0.99) << (same ? " OK\n" : " FAILED\n");
+
+    // Resumed estimator run collects no traces, and resume with other statistics is refused
+    RngStream estimator_rng;
+    RngStream estimator_rng_copy = estimator_rng;
+    System::Statistics estimator = system.run<COLLECT_ESTIMATOR>(estimator_rng);
+    system.set_time(500);
+    System::Checkpoint estimator_checkpoint = system.start<COLLECT_ESTIMATOR>(estimator_rng_copy);
+    system.resume<COLLECT_ESTIMATOR>(estimator_checkpoint);
+    system.set_time(1000);
+    bool refused = system.resume(estimator_checkpoint).cycle_cost_value.size() == estimator_checkpoint.stat.cycle_cost_value.size()
+                   && estimator_checkpoint.total_elapsed_time < 1000;
+    System::Statistics estimator_resumed = system.resume<COLLECT_ESTIMATOR>(estimator_checkpoint);
+    bool estimator_same = refused && estimator.cycle_cost_value == estimator_resumed.cycle_cost_value
+                          && estimator_resumed.male_interarrival_times.empty();
+    std::cout << "Resumed estimator run: " << estimator_resumed.cycle_cost_value.size() << " cycles" << (estimator_same ? " OK\n" : " FAILED\n");
+}
+
+// Replication i of run_lockstep uses the i-th new stream, so both paths start from the same package seed
+template <size_t Lanes, typename Real>
+bool lockstep_matches_scalar(Basic_system<Real> system, size_t n)
+{
+    const unsigned long seed[6] = {12345, 12345, 12345, 12345, 12345, 12345};
+    RngStream::SetPackageSeed(seed);
+    auto lockstep = run_lockstep<Lanes>(system, n);
+    RngStream::SetPackageSeed(seed);
+    std::vector<RngStream> streams(n);
+
+    bool same = lockstep.size() == n;
+    for (size_t i = 0; same && i < n; ++i)
+    {
+        auto scalar = system.template run<COLLECT_ESTIMATOR>(streams[i]);
+        same = lockstep[i].cycle_cost_value == scalar.cycle_cost_value && lockstep[i].cycle_male_arrivals == scalar.cycle_male_arrivals &&
+               lockstep[i].cycle_female_arrivals == scalar.cycle_female_arrivals && lockstep[i].downtime == scalar.downtime &&
+               lockstep[i].total_male_left == scalar.total_male_left && lockstep[i].total_female_left == scalar.total_female_left;
+    }
+    return same;
+}
+
+void test_lockstep()
+{
+    System system(20000, 1, 1, 3.5);
+    system.set_queues_limits(20, 20);
+    System tight(20000, 1, 1, 1);
+    tight.set_queues_limits(2, 3);
+
+    bool same = lockstep_matches_scalar<4>(system, 16) && lockstep_matches_scalar<8>(system, 16) &&
+                lockstep_matches_scalar<16>(system, 40) && lockstep_matches_scalar<8>(Basic_system<float>(system), 16) &&
+                lockstep_matches_scalar<8>(tight, 16);
+    std::cout << "Lock-step replications equal to scalar runs:" << (same ? " OK\n" : " FAILED\n");
+}
+
+void test_multiserver()
+{
+    // One server of capacity 1 is M/M/1 with arrival rate l1 + l2; cost is the queue area, so cost per customer is the mean wait
+    FP lambda = 0.6, mu = 1;
+    Multi_server_system system(200000, lambda / 2, lambda / 2, mu, {1});
+    Multi_server_system::Statistics stat = system.run();
+
+    Regenerative_accumulator cycles;
+    for (size_t c = 0; c < stat.cycle_cost_value.size(); ++c)
+        cycles.add(stat.cycle_cost_value[c], FP(stat.cycle_male_arrivals[c] + stat.cycle_female_arrivals[c]));
+    auto [lower, upper] = cycles.confidence_interval(0.99);
+    FP expected = lambda / mu / (mu - lambda);
+    std::cout << "M/M/1 mean wait " << cycles.value() << " [" << lower << ", " << upper << "], expected " << expected
+              << (lower <= expected && expected <= upper ? " OK\n" : " FAILED\n");
+
+    // Loader that asks for more customers than are queued
+    Multi_server_system greedy(1000, 1, 1, 0.5, {4, 4}, [](size_t, size_t, size_t) -> std::array<size_t, 2> { return {100, 100}; });
+    stat = greedy.run();
+    bool exist = stat.served <= stat.total_male + stat.total_female;
+    std::cout << "Served " << stat.served << " of " << stat.total_male + stat.total_female << " arrived" << (exist ? " OK\n" : " FAILED\n");
+}
+
+void test_distribution()
 {
     size_t N = 100;
     std::vector<double> v(N);
@@ -34,6 +154,88 @@ void test_distribution()
     print(v);
 }
 
+void test_ziggurat() 
+{
+    exponential_sampler = Exponential_sampler::ZIGGURAT;
+    validate_exponential_sampler(2, 1000000);
+
+    exponential_sampler = Exponential_sampler::INVERSION;
+    validate_exponential_sampler(2, 1000000);
+}
+
+// The Kolmogorov-Smirnov test cannot see single zero times, so position 0 of every layer is drawn on purpose
+void test_ziggurat_positive()
+{
+    RngStream rng;
+    size_t zeros = 0;
+    for (size_t i = 0; i < 256; ++i)
+    {
+        bool first = true;
+        auto uniform = [&]() { FP u = first ? i / 4294967296.0 : rng.RandU01(); first = false; return u; };
+        zeros += ziggurat_exponential<FP>(uniform) <= 0;
+        first = true;
+        zeros += ziggurat_exponential<float>(uniform) <= 0;
+    }
+    for (size_t n = 0; n < 10000000; ++n)
+        zeros += ziggurat_exponential<FP>(rng) <= 0;
+    std::cout << "Ziggurat draws that are not positive: " << zeros << (zeros == 0 ? " OK\n" : " FAILED\n");
+}
+
+void test_rng()
+{
+    Rng_test_settings settings;
+    settings.streams = 2 * omp_get_max_threads();
+    test_rng_streams(settings);
+}
+
+// SetPosition and AdvanceSubstream jump by the bits of the distance. Small positions are reached by declaring
+// streams, taking next substreams and drawing numbers; large ones by AdvanceState, which powers matrices itself
+void test_jump()
+{
+    const unsigned long seed[6] = {12345, 12345, 12345, 12345, 12345, 12345};
+    auto state = [](const RngStream& rng)
+    {
+        std::array<unsigned long, 6> s;
+        rng.GetState(s.data());
+        return s;
+    };
+    bool same = true;
+
+    for (auto [i, j, k] : {std::array<unsigned long long, 3>{0, 0, 0}, {3, 2, 5}, {1, 7, 1000}})
+    {
+        RngStream::SetPackageSeed(seed);
+        std::vector<RngStream> streams(i + 1);
+        RngStream stepped = streams[i], advanced = streams[i], jumped;
+        for (size_t n = 0; n < j; ++n)
+            stepped.ResetNextSubstream();
+        advanced.AdvanceSubstream(j);
+        same = same && state(stepped) == state(advanced);
+        for (size_t n = 0; n < k; ++n)
+            stepped.RandU01();
+        jumped.SetPosition(i, j, k);
+        same = same && state(stepped) == state(jumped);
+    }
+
+    // Stream 2^40 is 2^167 steps away, substream 2^33 + 3 is 2^109 + 3 * 2^76 steps, offset 2^33 + 7 is 2^34 - (2^33 - 7)
+    const unsigned long long i = 1ull << 40, j = (1ull << 33) + 3, k = (1ull << 33) + 7;
+    RngStream::SetPackageSeed(seed);
+    RngStream stepped, jumped, advanced;
+    stepped.AdvanceState(167, 0);
+    stepped.AdvanceState(109, 0);
+    std::array<unsigned long, 6> substream = state(stepped);
+    stepped.SetSeed(substream.data());
+    for (int n = 0; n < 3; ++n)
+        stepped.ResetNextSubstream();
+    advanced.SetPosition(i, 0, 0);
+    advanced.AdvanceSubstream(j);
+    same = same && state(stepped) == state(advanced);
+    stepped.AdvanceState(34, -long((1ull << 33) - 7));
+    jumped.SetPosition(i, j, k);
+    same = same && state(stepped) == state(jumped);
+
+    std::cout << "Jumps of SetPosition and AdvanceSubstream equal to steps:" << (same ? " OK\n" : " FAILED\n");
+}
+
 void test_arrivals_times() 
 {
     using namespace std;
@@ -60,12 +262,38 @@ std::vector<FP> operator+(const std::vector<F>& v, const std::vector<F>& w)
     return ans;
 }
 
-int main() 
+// Usage: out.exe [batch file [results file]]
+//        out.exe --monitor progress_file [period in seconds]
+// Without arguments runs the default experiment
+int main(int argc, char* argv[]) 
 {
     using namespace std;
 
+    if (argc > 2 && string(argv[1]) == "--monitor")
+    {
+        monitor_progress(argv[2], argc > 3 ? stod(argv[3]) : 1);
+        return 0;
+    }
+
+    if (argc > 1)
+    {
+        Batch batch;
+        if (!read_batch(argv[1], batch))
+            return 1;
+
+        auto results = run_batch(batch);
+        if (argc > 2)
+        {
+            ofstream out(argv[2]);
+            write_results_csv(out, results);
+        }
+        else
+            write_results_csv(cout, results);
+        return 0;
+    }
+
     System system(1000000, 1, 1, 3.5);
-    auto stat = system.run();
+    auto stat = system.run<COLLECT_ESTIMATOR>();
 
     auto Y = stat.cycle_cost_value;
     auto a = stat.cycle_male_arrivals + stat.cycle_female_arrivals;